@@ -4,9 +4,10 @@ set -euo pipefail
 echo 'Building all tests...'
 
 pushd ./src > /dev/null
-g++ -std=c++23 -O3 -s -DNDEBUG -pthread -I/usr/include/ -I/usr/local/include/ -L/usr/lib/ hash/*.cpp compressor/gzip_compressor.cpp kvs/*.cpp primegen/primegen.cpp -lz -lgtest -lgtest_main -o ../kvs_test
+g++ -std=c++23 -O3 -s -DNDEBUG -pthread -I/usr/include/ -I/usr/local/include/ -L/usr/lib/ hash/hash.cpp hash/MurmurHash3.cpp compressor/gzip_compressor.cpp compressor/lz4_compressor.cpp compressor/dictionary_compressor.cpp kvs/*.cpp primegen/primegen.cpp -lz -lgtest -lgtest_main -o ../kvs_test
 g++ -std=c++23 -O3 -s -DNDEBUG -pthread -I/usr/include/ -I/usr/local/include/ compressor/*.cpp -lz -lgtest -lgtest_main -o ../test_gzip
 g++ -std=c++23 -O3 -s -DNDEBUG -pthread -I/usr/include/ -I/usr/local/include/ server/protocol.cpp server/protocol_test.cpp -lgtest -lgtest_main -o ../protocol_test
+g++ -std=c++23 -O3 -s -DNDEBUG -pthread -I/usr/include/ -I/usr/local/include/ hash/*.cpp -lgtest -lgtest_main -o ../hash_test
 popd > /dev/null
 
 export NUM_ELEMENTS=10000000
@@ -22,4 +23,8 @@ echo 'Running gzip tests...'
 
 ./test_gzip
 
+echo 'Running hash tests...'
+
+./hash_test
+
 echo 'All tests completed successfully.'
@@ -0,0 +1,19 @@
+#!/bin/bash
+set -euo pipefail
+
+echo 'Building all benchmarks...'
+
+pushd ./src > /dev/null
+g++ -std=c++23 -O3 -s -DNDEBUG -pthread -I/usr/include/ -I/usr/local/include/ -L/usr/lib/ hash/hash.cpp hash/MurmurHash3.cpp compressor/gzip_compressor.cpp compressor/lz4_compressor.cpp compressor/dictionary_compressor.cpp kvs/kvs.cpp kvs/slab_allocator.cpp kvs/timing_wheel.cpp kvs/value_cache.cpp kvs/helper_pool.cpp kvs/epoch.cpp primegen/primegen.cpp bench/table_bench.cpp -lz -o ../table_bench
+g++ -std=c++23 -O3 -s -DNDEBUG -pthread -I/usr/include/ -I/usr/local/include/ -L/usr/lib/ compressor/gzip_compressor.cpp compressor/lz4_compressor.cpp compressor/dictionary_compressor.cpp bench/codec_bench.cpp -lz -o ../codec_bench
+popd > /dev/null
+
+echo 'Running table mode benchmark...'
+
+./table_bench ${BENCH_NUM_KEYS:-1000000}
+
+echo 'Running value codec benchmark...'
+
+./codec_bench tests/data
+
+echo 'All benchmarks completed successfully.'
@@ -0,0 +1,118 @@
+// Compares value codecs on a corpus of files: compression ratio and compress / decompress throughput
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../compressor/codec.hpp"
+
+/// @brief Size of fragments the corpus is cut into for the small value comparison
+#define SMALL_VALUE_SIZE 512
+
+struct CodecCase {
+    const char *name;
+    CodecId codec;
+    int level;
+    const CompressionDictionary *dictionary = nullptr;
+};
+
+/// @brief Compresses and decompresses every value iterations times, prints ratio and throughput
+static bool runCase(const CodecCase &c, const std::vector<std::string> &values, int iterations) {
+    size_t totalBytes = 0;
+    for (auto &value : values) {
+        totalBytes += value.size();
+    }
+    size_t compressedBytes = 0;
+    std::vector<CompressResult> compressed(values.size());
+    double compressSec = 0, decompressSec = 0;
+    for (int it = 0; it < iterations; ++it) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < values.size(); ++i) {
+            compressed[i] = ValueCodec::Compress(c.codec, values[i].data(), values[i].size(), c.level, c.dictionary);
+        }
+        auto mid = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < values.size(); ++i) {
+            auto decompressed = ValueCodec::Decompress(c.codec, compressed[i].data, compressed[i].size, c.dictionary);
+            if (decompressed.operationResult != OPERATION_SUCCESS || decompressed.size != values[i].size()) {
+                std::cerr << c.name << " round trip failed" << std::endl;
+                return false;
+            }
+            delete[] decompressed.data;
+        }
+        auto stop = std::chrono::steady_clock::now();
+        compressSec += std::chrono::duration<double>(mid - start).count();
+        decompressSec += std::chrono::duration<double>(stop - mid).count();
+
+        compressedBytes = 0;
+        for (auto &result : compressed) {
+            compressedBytes += result.size;
+            delete[] result.data;
+        }
+    }
+    auto totalMb = static_cast<double>(totalBytes) * iterations / (1024 * 1024);
+    std::cout << std::left << std::setw(16) << c.name << std::fixed << std::setprecision(3)
+              << " ratio = " << static_cast<double>(totalBytes) / compressedBytes
+              << std::setprecision(1)
+              << " compress = " << std::setw(7) << totalMb / compressSec << " MB/s"
+              << " decompress = " << std::setw(7) << totalMb / decompressSec << " MB/s\n";
+    return true;
+}
+
+int main(int argc, char **argv) {
+    std::string corpusDir = argc > 1 ? argv[1] : "tests/data";
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    std::vector<std::string> corpus;
+    size_t corpusBytes = 0;
+    for (auto &file : std::filesystem::directory_iterator(corpusDir)) {
+        if (file.path().extension() != ".json") continue;
+        std::ifstream input(file.path(), std::ios::binary);
+        std::stringstream content;
+        content << input.rdbuf();
+        corpus.push_back(content.str());
+        corpusBytes += corpus.back().size();
+    }
+    if (corpus.empty()) {
+        std::cerr << "No .json files found in " << corpusDir << std::endl;
+        return 1;
+    }
+    std::cout << "files = " << corpus.size() << ", bytes = " << corpusBytes << ", iterations = " << iterations << "\n";
+
+    const CodecCase cases[] = {
+        { "lz4", CodecId::Lz4, 0 },
+        { "gzip -1", CodecId::Gzip, 1 },
+        { "gzip -6", CodecId::Gzip, 6 },
+        { "gzip -9", CodecId::Gzip, 9 },
+    };
+    for (auto &c : cases) {
+        if (!runCase(c, corpus, iterations)) return 1;
+    }
+
+    // Small values: corpus cut into fragments, dictionary is trained on every other fragment and measured on the rest
+    std::vector<std::string> trainingValues, smallValues;
+    for (auto &document : corpus) {
+        for (size_t offset = 0; offset < document.size(); offset += SMALL_VALUE_SIZE) {
+            auto &target = (offset / SMALL_VALUE_SIZE) % 2 ? smallValues : trainingValues;
+            target.push_back(document.substr(offset, SMALL_VALUE_SIZE));
+        }
+    }
+    auto trainStart = std::chrono::steady_clock::now();
+    CompressionDictionary dictionary { 1, DictionaryCompressor::Train(trainingValues, DICT_DEFAULT_SIZE) };
+    auto trainUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - trainStart).count();
+    std::cout << "small values = " << smallValues.size() << " x " << SMALL_VALUE_SIZE << " bytes, dictionary = "
+              << dictionary.data.size() << " bytes trained in " << trainUs << "us\n";
+
+    const CodecCase smallCases[] = {
+        { "lz4", CodecId::Lz4, 0 },
+        { "gzip -6", CodecId::Gzip, 6 },
+        { "deflate-dict -1", CodecId::DeflateDict, 1, &dictionary },
+        { "deflate-dict -6", CodecId::DeflateDict, 6, &dictionary },
+    };
+    for (auto &c : smallCases) {
+        if (!runCase(c, smallValues, iterations * 4)) return 1;
+    }
+    return 0;
+}
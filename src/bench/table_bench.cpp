@@ -0,0 +1,180 @@
+// Compares prime (modulo) and power of two (mask) table modes: probe distribution and set / get speed,
+// then measures blocking resize with 1 to N rehash threads and lock-free reads with 1 to N reader threads next to a writer
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../kvs/kvs.hpp"
+
+using namespace kvs;
+
+struct Distribution {
+    double stddev;
+    uint_fast64_t maxLoad;
+    double usedShare;
+};
+
+static Distribution measureDistribution(const std::vector<uint_fast64_t> &hashes, uint_fast64_t numBuckets, bool prime) {
+    std::vector<uint_fast64_t> load(numBuckets);
+    for (auto hash : hashes) {
+        ++load[prime ? hash % numBuckets : hash & (numBuckets - 1)];
+    }
+    double mean = static_cast<double>(hashes.size()) / numBuckets;
+    double sumSquares = 0;
+    uint_fast64_t maxLoad = 0, used = 0;
+    for (auto count : load) {
+        sumSquares += (count - mean) * (count - mean);
+        maxLoad = std::max(maxLoad, count);
+        used += count != 0;
+    }
+    return Distribution { std::sqrt(sumSquares / numBuckets), maxLoad, static_cast<double>(used) / numBuckets };
+}
+
+static void printDistribution(const char *name, const Distribution &d) {
+    std::cout << std::left << std::setw(44) << name << " stddev = " << std::setw(10) << d.stddev
+              << " maxLoad = " << std::setw(6) << d.maxLoad << " usedBuckets = " << d.usedShare * 100 << "%\n";
+}
+
+static void benchmarkMode(const std::vector<std::string> &keys, bool prime) {
+    KeyValueStoreSettings settings;
+    settings.usePrimeNumbers = prime;
+    settings.compressionEnabled = false;
+    KeyValueStore kvStore(settings);
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto &key : keys) {
+        kvStore.set(key.data(), key.size(), key.data(), key.size());
+    }
+    while (kvStore.maintenance());
+    auto setDone = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (int round = 0; round < 3; ++round) {
+        for (auto &key : keys) {
+            found += static_cast<bool>(kvStore.get(key.data(), key.size()));
+        }
+    }
+    auto getDone = std::chrono::steady_clock::now();
+
+    auto setNs = std::chrono::duration<double, std::nano>(setDone - start).count() / keys.size();
+    auto getNs = std::chrono::duration<double, std::nano>(getDone - setDone).count() / (keys.size() * 3);
+    std::cout << (prime ? "prime" : "pow2 ") << ": tableSize = " << kvStore.getTableSize()
+              << " set = " << setNs << " ns/op, get = " << getNs << " ns/op, found = " << found / 3 << "\n";
+}
+
+static void benchmarkRehash(const std::vector<std::string> &keys, uint_fast32_t threads) {
+    KeyValueStoreSettings settings;
+    settings.compressionEnabled = false;
+    settings.incrementalResize = false;
+    settings.rehashThreads = threads;
+    KeyValueStore kvStore(settings);
+
+    // The slowest set is the one which rehashed the largest table
+    double maxPauseMs = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto &key : keys) {
+        auto setStart = std::chrono::steady_clock::now();
+        kvStore.set(key.data(), key.size(), key.data(), key.size());
+        maxPauseMs = std::max(maxPauseMs, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setStart).count());
+    }
+    auto setNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / keys.size();
+    std::cout << "blocking resize, threads = " << std::setw(3) << threads << ": tableSize = " << kvStore.getTableSize()
+              << " set = " << setNs << " ns/op, max pause = " << maxPauseMs << " ms\n";
+}
+
+static void benchmarkConcurrentReads(const std::vector<std::string> &keys, uint_fast32_t threads) {
+    KeyValueStoreSettings settings;
+    settings.compressionEnabled = false;
+    settings.concurrentReads = true;
+    KeyValueStore kvStore(settings);
+    for (auto &key : keys) {
+        kvStore.set(key.data(), key.size(), key.data(), key.size());
+    }
+    while (kvStore.maintenance());
+
+    std::atomic<bool> stop = false;
+    // Writer keeps overwriting keys, so readers pay for retries and deferred frees too
+    std::thread writer([&] {
+        for (size_t i = 0; !stop.load(std::memory_order_relaxed); i = (i + 7919) % keys.size()) {
+            kvStore.set(keys[i].data(), keys[i].size(), keys[i].data(), keys[i].size());
+        }
+    });
+    std::atomic<uint_fast64_t> conflicts = 0;
+    std::vector<std::thread> readers;
+    auto start = std::chrono::steady_clock::now();
+    for (uint_fast32_t t = 0; t < threads; ++t) {
+        readers.emplace_back([&, t] {
+            std::string value;
+            uint_fast64_t numConflicts = 0;
+            for (size_t i = t; i < keys.size(); i += threads) {
+                auto hash = hashFunc(keys[i].data(), keys[i].size());
+                numConflicts += kvStore.readConcurrent(keys[i].data(), keys[i].size(), hash, value) == ReadResult::Conflict;
+            }
+            conflicts += numConflicts;
+        });
+    }
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    auto readNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / keys.size();
+    stop = true;
+    writer.join();
+    std::cout << "concurrent reads, threads = " << std::setw(3) << threads << ": read = " << readNs << " ns/op (all threads)"
+              << ", conflicts = " << conflicts.load() << "\n";
+}
+
+int main(int argc, char **argv) {
+    size_t numKeys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    uint_fast32_t numShards = 24;
+
+    std::vector<std::string> keys;
+    std::vector<uint_fast64_t> hashes;
+    keys.reserve(numKeys);
+    hashes.reserve(numKeys);
+    for (size_t i = 0; i < numKeys; ++i) {
+        keys.push_back("key:" + std::to_string(i));
+        hashes.push_back(hashFunc(keys.back().data(), keys.back().size()));
+    }
+
+    // Bucket distribution at comparable table sizes with at least 4 keys per bucket on average
+    uint_fast64_t primeBuckets = PRIME_SEQUENCE.front();
+    for (auto prime : PRIME_SEQUENCE) {
+        if (prime * 4 > numKeys) break;
+        primeBuckets = prime;
+    }
+    auto pow2Buckets = std::bit_floor(primeBuckets);
+    std::cout << "keys = " << numKeys << ", prime buckets = " << primeBuckets << ", pow2 buckets = " << pow2Buckets << "\n";
+    printDistribution("prime, whole table", measureDistribution(hashes, primeBuckets, true));
+    printDistribution("pow2, whole table", measureDistribution(hashes, pow2Buckets, false));
+
+    // Keys of a single shard, with hash % numShards the shard fixes the low hash bits which pow2 mode uses for buckets
+    std::vector<uint_fast64_t> moduloShard, rangeShard;
+    for (auto hash : hashes) {
+        if (hash % numShards == 0) moduloShard.push_back(hash);
+        if (shardIndex(hash, numShards) == 0) rangeShard.push_back(hash);
+    }
+    auto shardBuckets = std::bit_floor(std::max<uint_fast64_t>(moduloShard.size() / 4, 1));
+    printDistribution("pow2, shard by hash % numShards", measureDistribution(moduloShard, shardBuckets, false));
+    printDistribution("pow2, shard by shardIndex", measureDistribution(rangeShard, shardBuckets, false));
+    printDistribution("prime, shard by hash % numShards", measureDistribution(moduloShard, PRIME_SEQUENCE.front(), true));
+    printDistribution("prime, shard by shardIndex", measureDistribution(rangeShard, PRIME_SEQUENCE.front(), true));
+
+    benchmarkMode(keys, true);
+    benchmarkMode(keys, false);
+
+    auto maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (uint_fast32_t threads = 1; threads < maxThreads; threads *= 2) {
+        benchmarkRehash(keys, threads);
+    }
+    benchmarkRehash(keys, maxThreads);
+
+    for (uint_fast32_t threads = 1; threads < maxThreads; threads *= 2) {
+        benchmarkConcurrentReads(keys, threads);
+    }
+    benchmarkConcurrentReads(keys, maxThreads);
+    return 0;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <numbers>
+#include <algorithm>
+#include "gzip_compressor.hpp"
+#include "lz4_compressor.hpp"
+#include "dictionary_compressor.hpp"
+
+/// @brief Compressibility of larger values is estimated from this many evenly spaced chunks
+#define COMPRESSIBILITY_SAMPLE_CHUNKS 4
+#define COMPRESSIBILITY_CHUNK_SIZE 128
+/// @brief log2 of the number of entries in the repeat finder of the estimator
+#define COMPRESSIBILITY_HASH_LOG 11
+
+/// @brief Codec a stored value is encoded with, recorded per entry so values written with different codecs can coexist
+enum class CodecId : uint8_t {
+    /// @brief Value is stored as is
+    None = 0,
+    /// @brief Gzip (deflate with gzip header and CRC), best ratio, slowest
+    Gzip = 1,
+    /// @brief LZ4 block format, several times faster than gzip in both directions with a lower ratio
+    Lz4 = 2,
+    /// @brief Raw deflate primed with a dictionary trained from stored values, the dictionary id is part of the value bytes
+    DeflateDict = 3,
+};
+
+/// @brief Dispatches compression to the codec selected at runtime
+class ValueCodec {
+    public:
+        /// @param level Compression level, used by codecs which support levels (gzip, deflate)
+        /// @param dictionary Required by CodecId::DeflateDict, ignored by other codecs
+        static CompressResult Compress(CodecId codec, const char* input, size_t length, int level = GZIP_DEFAULT_LEVEL, const CompressionDictionary* dictionary = nullptr) {
+            switch (codec) {
+                case CodecId::Gzip: return GzipCompressor::Compress(input, length, level);
+                case CodecId::Lz4: return Lz4Compressor::Compress(input, length);
+                case CodecId::DeflateDict:
+                    return dictionary ? DictionaryCompressor::Compress(input, length, *dictionary, level) : CompressResult{ nullptr, 0, DICT_MISSING };
+                default: return { nullptr, 0, INVALID_INPUT };
+            }
+        }
+
+        /// @param dictionary Dictionary the value was compressed with, required by CodecId::DeflateDict
+        static DecompressResult Decompress(CodecId codec, const char* input, size_t input_size, const CompressionDictionary* dictionary = nullptr) {
+            switch (codec) {
+                case CodecId::Gzip: return GzipCompressor::Decompress(input, input_size);
+                case CodecId::Lz4: return Lz4Compressor::Decompress(input, input_size);
+                case CodecId::DeflateDict:
+                    return dictionary ? DictionaryCompressor::Decompress(input, input_size, *dictionary) : DecompressResult{ nullptr, 0, DICT_MISSING };
+                default: return { nullptr, 0, INVALID_INPUT };
+            }
+        }
+
+        /// @brief Approximate number of bytes the codec adds to every value regardless of its content (headers, trailers, block markers)
+        static constexpr size_t FrameOverhead(CodecId codec) noexcept {
+            switch (codec) {
+                case CodecId::Gzip: return 20;
+                case CodecId::Lz4: return LZ4_SIZE_PREFIX + 1;
+                case CodecId::DeflateDict: return DICT_HEADER_SIZE + 2;
+                default: return 0;
+            }
+        }
+
+        /// @brief Cheap estimate of how much the codec would save on the input, in percent of its size.
+        /// Sampled bytes found repeated 4 bytes at a time are assumed to compress away, the rest costs its order-0 entropy with codecs
+        /// which have an entropy coder (deflate) and full size with those which do not (LZ4), plus the frame overhead. Random tokens, compressed images and
+        /// (for LZ4) base64 blobs score close to 0, so compressing them can be skipped without trying
+        static uint32_t EstimateSavingsPercent(CodecId codec, const char* input, size_t length) noexcept {
+            if (codec == CodecId::None || !input || length < 4) {
+                return 0;
+            }
+            char sample[COMPRESSIBILITY_SAMPLE_CHUNKS * COMPRESSIBILITY_CHUNK_SIZE];
+            size_t sampleSize = std::min(length, sizeof(sample));
+            if (length <= sizeof(sample)) {
+                memcpy(sample, input, length);
+            } else {
+                auto stride = (length - COMPRESSIBILITY_CHUNK_SIZE) / (COMPRESSIBILITY_SAMPLE_CHUNKS - 1);
+                for (size_t c = 0; c < COMPRESSIBILITY_SAMPLE_CHUNKS; ++c) {
+                    memcpy(sample + c * COMPRESSIBILITY_CHUNK_SIZE, input + c * stride, COMPRESSIBILITY_CHUNK_SIZE);
+                }
+            }
+
+            uint16_t lastSeen[1 << COMPRESSIBILITY_HASH_LOG] = {};
+            uint32_t histogram[256] = {};
+            size_t repeated = 0;
+            for (size_t i = 0; i < sampleSize; ++i) {
+                ++histogram[static_cast<unsigned char>(sample[i])];
+                if (i + 4 > sampleSize) continue;
+                uint32_t window;
+                memcpy(&window, sample + i, 4);
+                auto h = (window * 2654435761u) >> (32 - COMPRESSIBILITY_HASH_LOG);
+                // Positions are stored off by one, 0 marks an empty entry
+                auto previous = lastSeen[h];
+                if (previous && memcmp(sample + previous - 1, sample + i, 4) == 0) {
+                    ++repeated;
+                }
+                lastSeen[h] = static_cast<uint16_t>(i + 1);
+            }
+
+            double literalCost = 1.0;
+            if (codec != CodecId::Lz4) {
+                double entropy = 0;
+                size_t distinct = 0;
+                for (auto count : histogram) {
+                    if (!count) continue;
+                    auto p = static_cast<double>(count) / sampleSize;
+                    entropy -= p * std::log2(p);
+                    ++distinct;
+                }
+                // Miller-Madow correction, entropy of a few hundred bytes is underestimated otherwise
+                entropy += (distinct - 1) / (2.0 * sampleSize * std::numbers::ln2);
+                literalCost = std::min(entropy / 8, 1.0);
+            }
+            auto literalFraction = 1.0 - static_cast<double>(repeated) / sampleSize;
+            auto estimatedSize = literalFraction * literalCost * length + FrameOverhead(codec);
+            return static_cast<uint32_t>(std::max(0.0, (1.0 - estimatedSize / length) * 100));
+        }
+
+        static const char* Name(CodecId codec) noexcept {
+            switch (codec) {
+                case CodecId::Gzip: return "gzip";
+                case CodecId::Lz4: return "lz4";
+                case CodecId::DeflateDict: return "deflate-dict";
+                default: return "none";
+            }
+        }
+};
@@ -0,0 +1,295 @@
+#include "dictionary_compressor.hpp"
+
+namespace {
+    /// @brief Raw deflate streams of the calling thread, dictionaries are set after every reset
+    struct ThreadStreams {
+        z_stream deflater{};
+        z_stream inflater{};
+        bool deflaterReady = false;
+        bool inflaterReady = false;
+        int deflaterLevel = 0;
+
+        ~ThreadStreams() {
+            if (deflaterReady) {
+                deflateEnd(&deflater);
+            }
+            if (inflaterReady) {
+                inflateEnd(&inflater);
+            }
+        }
+    };
+
+    thread_local ThreadStreams streams;
+
+    int acquireDeflater(int level) {
+        if (streams.deflaterReady && streams.deflaterLevel == level) {
+            return deflateReset(&streams.deflater);
+        }
+        if (streams.deflaterReady) {
+            deflateEnd(&streams.deflater);
+            streams.deflaterReady = false;
+        }
+        streams.deflater = z_stream{};
+        auto operationResult = deflateInit2(&streams.deflater, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+        if (operationResult == Z_OK) {
+            streams.deflaterReady = true;
+            streams.deflaterLevel = level;
+        }
+        return operationResult;
+    }
+
+    int acquireInflater() {
+        if (streams.inflaterReady) {
+            return inflateReset(&streams.inflater);
+        }
+        streams.inflater = z_stream{};
+        auto operationResult = inflateInit2(&streams.inflater, -15);
+        streams.inflaterReady = operationResult == Z_OK;
+        return operationResult;
+    }
+
+    uint64_t loadKmer(const char* data) noexcept {
+        uint64_t kmer;
+        memcpy(&kmer, data, DICT_KMER_SIZE);
+        return kmer;
+    }
+}
+
+CompressResult DictionaryCompressor::Compress(const char* input, size_t input_length, const CompressionDictionary& dictionary, int level) {
+    if (!input || input_length == 0 || input_length > UINT32_MAX) return { nullptr, 0, INVALID_INPUT };
+
+    auto operationResult = acquireDeflater(level);
+    if (operationResult != Z_OK) {
+        return { nullptr, 0, operationResult };
+    }
+    auto& strm = streams.deflater;
+    if (!dictionary.data.empty()) {
+        operationResult = deflateSetDictionary(&strm, reinterpret_cast<const Bytef*>(dictionary.data.data()), static_cast<uInt>(dictionary.data.size()));
+        if (operationResult != Z_OK) {
+            return { nullptr, 0, operationResult };
+        }
+    }
+
+    auto buffer_size = DICT_HEADER_SIZE + deflateBound(&strm, static_cast<uLong>(input_length));
+    auto output = new char[buffer_size];
+    auto header = reinterpret_cast<unsigned char*>(output);
+    header[0] = static_cast<unsigned char>(dictionary.id);
+    header[1] = static_cast<unsigned char>(dictionary.id >> 8);
+    for (int i = 0; i < 4; ++i) {
+        header[2 + i] = static_cast<unsigned char>(input_length >> (8 * i));
+    }
+
+    strm.avail_in = static_cast<uInt>(input_length);
+    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+    strm.avail_out = static_cast<uInt>(buffer_size - DICT_HEADER_SIZE);
+    strm.next_out = reinterpret_cast<Bytef*>(output + DICT_HEADER_SIZE);
+
+    operationResult = deflate(&strm, Z_FINISH);
+    if (operationResult != Z_STREAM_END) {
+        delete[] output;
+        return { nullptr, 0, operationResult };
+    }
+    return { output, DICT_HEADER_SIZE + static_cast<size_t>(strm.total_out), OPERATION_SUCCESS };
+}
+
+DecompressResult DictionaryCompressor::Decompress(const char* input, size_t input_size, const CompressionDictionary& dictionary) {
+    if (!input || input_size <= DICT_HEADER_SIZE) return { nullptr, 0, INVALID_INPUT };
+    if (DictionaryId(input) != dictionary.id) return { nullptr, 0, DICT_MISSING };
+
+    auto header = reinterpret_cast<const unsigned char*>(input);
+    size_t output_size = static_cast<size_t>(header[2]) | (static_cast<size_t>(header[3]) << 8)
+                       | (static_cast<size_t>(header[4]) << 16) | (static_cast<size_t>(header[5]) << 24);
+    // Deflate can not expand data more than ~1032 times, bigger sizes come from corrupted headers only
+    if (output_size == 0 || output_size / 1032 > input_size) return { nullptr, 0, INVALID_INPUT };
+
+    auto operationResult = acquireInflater();
+    if (operationResult != Z_OK) {
+        return { nullptr, 0, operationResult };
+    }
+    auto& strm = streams.inflater;
+    if (!dictionary.data.empty()) {
+        operationResult = inflateSetDictionary(&strm, reinterpret_cast<const Bytef*>(dictionary.data.data()), static_cast<uInt>(dictionary.data.size()));
+        if (operationResult != Z_OK) {
+            return { nullptr, 0, operationResult };
+        }
+    }
+
+    auto output = new char[output_size + 1];
+    strm.avail_in = static_cast<uInt>(input_size - DICT_HEADER_SIZE);
+    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input + DICT_HEADER_SIZE));
+    strm.avail_out = static_cast<uInt>(output_size);
+    strm.next_out = reinterpret_cast<Bytef*>(output);
+
+    operationResult = inflate(&strm, Z_FINISH);
+    if (operationResult != Z_STREAM_END || strm.total_out != output_size) {
+        delete[] output;
+        return { nullptr, 0, operationResult == Z_STREAM_END || operationResult == Z_OK ? Z_BUF_ERROR : operationResult };
+    }
+    output[output_size] = '\0';
+    return { output, output_size, OPERATION_SUCCESS };
+}
+
+std::string DictionaryCompressor::Train(const std::vector<std::string>& samples, size_t dictionarySize) {
+    DictionaryTrainer trainer(samples, dictionarySize);
+    while (!trainer.step(SIZE_MAX));
+    return trainer.takeDictionary();
+}
+
+DictionaryTrainer::DictionaryTrainer(std::vector<std::string> samples, size_t dictionarySize)
+    : samples(std::move(samples)), dictionarySize(dictionarySize) {}
+
+size_t DictionaryTrainer::segmentLength(const Segment& segment) const noexcept {
+    return std::min<size_t>(DICT_SEGMENT_SIZE, samples[segment.sample].size() - segment.offset);
+}
+
+uint64_t DictionaryTrainer::score(const Segment& segment) const {
+    uint64_t total = 0;
+    auto data = samples[segment.sample].data() + segment.offset;
+    auto length = segmentLength(segment);
+    for (size_t i = 0; i + DICT_KMER_SIZE <= length; ++i) {
+        auto it = frequency.find(loadKmer(data + i));
+        if (it != frequency.end() && it->second > 1) {
+            total += it->second;
+        }
+    }
+    return total;
+}
+
+bool DictionaryTrainer::step(size_t budgetBytes) {
+    size_t workBytes = 0;
+    while (workBytes < budgetBytes && phase == Phase::Count) {
+        if (cursor == samples.size()) {
+            phase = Phase::Score;
+            cursor = 0;
+            break;
+        }
+        auto& sample = samples[cursor++];
+        workBytes += sample.size();
+        if (sample.size() < DICT_KMER_SIZE) continue;
+        kmers.clear();
+        for (size_t i = 0; i + DICT_KMER_SIZE <= sample.size(); ++i) {
+            kmers.push_back(loadKmer(sample.data() + i));
+        }
+        std::sort(kmers.begin(), kmers.end());
+        kmers.erase(std::unique(kmers.begin(), kmers.end()), kmers.end());
+        for (auto kmer : kmers) {
+            ++frequency[kmer];
+        }
+    }
+
+    // Candidate segments overlap by 3/4, so a shared fragment is not cut in half by a fixed grid
+    while (workBytes < budgetBytes && phase == Phase::Score) {
+        if (cursor == samples.size()) {
+            phase = Phase::Select;
+            kmers = {};
+            break;
+        }
+        auto s = cursor++;
+        for (uint32_t offset = 0; offset + DICT_KMER_SIZE <= samples[s].size(); offset += DICT_SEGMENT_SIZE / 4) {
+            Segment segment { 0, s, offset };
+            segment.score = score(segment);
+            workBytes += segmentLength(segment);
+            if (segment.score) {
+                candidates.push(segment);
+            }
+        }
+    }
+
+    // Greedy cover: take the best segment, then forget its substrings so the next ones add new content.
+    // Scores only go down, so a stale top is rescored and taken if it still beats the next best stale score
+    while (workBytes < budgetBytes && phase == Phase::Select) {
+        if (pickedBytes >= dictionarySize || candidates.empty()) {
+            assemble();
+            break;
+        }
+        auto top = candidates.top();
+        candidates.pop();
+        auto length = segmentLength(top);
+        workBytes += length;
+        auto current = score(top);
+        if (current == 0) continue;
+        if (current < top.score && !candidates.empty() && current < candidates.top().score) {
+            top.score = current;
+            candidates.push(top);
+            continue;
+        }
+        auto data = samples[top.sample].data() + top.offset;
+        for (size_t i = 0; i + DICT_KMER_SIZE <= length; ++i) {
+            auto it = frequency.find(loadKmer(data + i));
+            if (it != frequency.end()) {
+                it->second = 0;
+            }
+        }
+        picked.push_back(top);
+        pickedBytes += length;
+    }
+    return phase == Phase::Done;
+}
+
+void DictionaryTrainer::assemble() {
+    dictionary.reserve(pickedBytes);
+    for (auto it = picked.rbegin(); it != picked.rend(); ++it) {
+        dictionary.append(samples[it->sample].data() + it->offset, segmentLength(*it));
+    }
+    if (dictionary.size() > dictionarySize) {
+        dictionary.erase(0, dictionary.size() - dictionarySize);
+    }
+    phase = Phase::Done;
+}
+
+void DictionarySet::startTraining() {
+    trainer = std::make_unique<DictionaryTrainer>(std::move(samples), dictionarySize);
+    samples = {};
+    sampledBytes = 0;
+    offersUntilSampling = DICT_RETRAIN_INTERVAL;
+}
+
+bool DictionarySet::trainStep(size_t budgetBytes) {
+    if (!trainer) {
+        if (!trainingPending()) {
+            return false;
+        }
+        startTraining();
+    }
+    if (!trainer->step(budgetBytes)) {
+        return true;
+    }
+    install(trainer->takeDictionary());
+    trainer.reset();
+    return false;
+}
+
+bool DictionarySet::train() {
+    if (!trainer) {
+        startTraining();
+    }
+    while (!trainer->step(SIZE_MAX));
+    auto trained = install(trainer->takeDictionary());
+    trainer.reset();
+    return trained;
+}
+
+bool DictionarySet::install(std::string data) {
+    if (data.empty()) {
+        return false;
+    }
+    // Ids wrap around, skip the ones of dictionaries which are still referred to
+    while (nextId == 0 || dictionaries.contains(nextId)) {
+        ++nextId;
+    }
+    auto id = nextId++;
+    auto& slot = dictionaries[id];
+    slot.dictionary.id = id;
+    slot.dictionary.data = std::move(data);
+
+    if (currentDictionary) {
+        auto previous = dictionaries.find(currentDictionary->id);
+        currentDictionary = &slot.dictionary;
+        if (previous->second.refs == 0) {
+            dictionaries.erase(previous);
+        }
+    }
+    currentDictionary = &slot.dictionary;
+    ++numTrained;
+    return true;
+}
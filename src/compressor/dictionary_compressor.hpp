@@ -0,0 +1,235 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include "gzip_compressor.hpp"
+
+/// @brief Decompress result code when the dictionary a value was compressed with is not available
+#define DICT_MISSING -997
+/// @brief Dictionary id (2 bytes) and uncompressed length (4 bytes), both little endian, written before the raw deflate stream
+#define DICT_HEADER_SIZE 6
+/// @brief Dictionary size used when none is given, deflate only looks 32KB back so larger dictionaries are pointless
+#define DICT_DEFAULT_SIZE 16384
+#define DICT_MAX_SIZE 32768
+/// @brief Length of substrings the trainer counts, shorter repeats are not worth a back reference anyway
+#define DICT_KMER_SIZE 8
+/// @brief Length of sample fragments the trainer assembles the dictionary from
+#define DICT_SEGMENT_SIZE 64
+/// @brief Values shorter than this still are not compressed, even a dictionary match costs a few bytes
+#define DICT_MIN_SIZE_TO_COMPRESS 16
+/// @brief Larger values compress well on their own, the dictionary is used (and trained) for smaller ones only
+#define DICT_MAX_VALUE_SIZE 4096
+/// @brief One of this many offered values is sampled for training
+#define DICT_SAMPLE_INTERVAL 8
+/// @brief Training starts once sampled values add up to this many dictionary sizes
+#define DICT_SAMPLE_SIZE_FACTOR 8
+/// @brief Dictionary is retrained once this many values were offered after the last training, so it follows changing values
+#define DICT_RETRAIN_INTERVAL (1 << 20)
+/// @brief Bytes of samples the trainer works through in a single step, keeps a step under a millisecond
+#define DICT_TRAIN_STEP_BYTES 16384
+
+/// @brief Shared deflate dictionary, the id is stored in every value compressed with it
+struct CompressionDictionary {
+    uint16_t id = 0;
+    std::string data;
+};
+
+/// @brief Raw deflate primed with a shared dictionary, so values of a few hundred bytes can refer to content common to all values
+/// instead of starting with an empty window. Output is DICT_HEADER_SIZE bytes of header followed by a raw deflate stream without gzip wrapper
+class DictionaryCompressor {
+    public:
+        /// @brief Compresses the first length bytes of input with the dictionary. You are responsible to delete[] the memory!
+        /// @return Pointer to compressed data on success, nullptr on error
+        static CompressResult Compress(const char* input, size_t length, const CompressionDictionary& dictionary, int level = GZIP_DEFAULT_LEVEL);
+
+        /// @brief Decompresses data produced by Compress with the same dictionary, you are responsible to delete[] the memory!
+        /// @return Pointer to decompressed data on success (zero terminated, size does not include terminator), nullptr on error
+        static DecompressResult Decompress(const char* input, size_t input_size, const CompressionDictionary& dictionary);
+
+        /// @brief Id of the dictionary compressed data was produced with
+        static uint16_t DictionaryId(const char* input) noexcept {
+            auto bytes = reinterpret_cast<const unsigned char*>(input);
+            return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+        }
+
+        /// @brief Builds a dictionary of at most dictionarySize bytes from fragments of the samples which share the most substrings
+        /// with other samples. Most useful fragments are placed at the end, where deflate references are the cheapest
+        static std::string Train(const std::vector<std::string>& samples, size_t dictionarySize);
+};
+
+/// @brief DictionaryCompressor::Train split into steps of bounded work, so a dictionary can be trained between requests without stalling them
+class DictionaryTrainer {
+    private:
+        /// @brief Fragment of a sample considered for the dictionary
+        struct Segment {
+            uint64_t score;
+            uint32_t sample;
+            uint32_t offset;
+
+            bool operator<(const Segment& other) const noexcept {
+                return score < other.score;
+            }
+        };
+
+        enum class Phase : uint8_t {
+            /// @brief Counting samples every substring occurs in
+            Count,
+            /// @brief Scoring candidate segments
+            Score,
+            /// @brief Picking the best segments
+            Select,
+            Done,
+        };
+
+        std::vector<std::string> samples;
+        size_t dictionarySize;
+        Phase phase = Phase::Count;
+        /// @brief Next sample of the Count and Score phases
+        uint32_t cursor = 0;
+        /// @brief Number of samples each substring occurs in, substrings found in a single sample do not help other values
+        std::unordered_map<uint64_t, uint32_t> frequency;
+        std::vector<uint64_t> kmers;
+        std::priority_queue<Segment> candidates;
+        std::vector<Segment> picked;
+        size_t pickedBytes = 0;
+        std::string dictionary;
+
+        size_t segmentLength(const Segment& segment) const noexcept;
+        uint64_t score(const Segment& segment) const;
+        void assemble();
+
+    public:
+        DictionaryTrainer(std::vector<std::string> samples, size_t dictionarySize);
+
+        /// @brief Advances training by about budgetBytes of sample bytes, at least a single sample or segment
+        /// @return true once the dictionary is built
+        bool step(size_t budgetBytes = DICT_TRAIN_STEP_BYTES);
+
+        bool done() const noexcept {
+            return phase == Phase::Done;
+        }
+
+        /// @brief Built dictionary, empty if samples share too little content
+        std::string takeDictionary() {
+            return std::move(dictionary);
+        }
+};
+
+/// @brief Dictionaries of a single store: samples values, trains the current dictionary and keeps older ones while values still refer to them
+class DictionarySet {
+    private:
+        struct Slot {
+            CompressionDictionary dictionary;
+            /// @brief Number of stored values compressed with the dictionary
+            uint64_t refs = 0;
+        };
+
+        size_t dictionarySize;
+        std::unordered_map<uint16_t, Slot> dictionaries;
+        const CompressionDictionary* currentDictionary = nullptr;
+        uint16_t nextId = 1;
+
+        std::vector<std::string> samples;
+        size_t sampledBytes = 0;
+        /// @brief Training in progress, samples are moved into it
+        std::unique_ptr<DictionaryTrainer> trainer;
+        uint64_t numOffered = 0;
+        uint64_t offersUntilSampling = 0;
+        uint64_t numTrained = 0;
+
+        void startTraining();
+        /// @brief Makes trained dictionary data current
+        /// @return false if the data is empty
+        bool install(std::string data);
+
+    public:
+        /// @param dictionarySize Max dictionary size, 0 disables sampling and training
+        explicit DictionarySet(size_t dictionarySize = 0) : dictionarySize(std::min<size_t>(dictionarySize, DICT_MAX_SIZE)) {}
+
+        bool enabled() const noexcept {
+            return dictionarySize != 0;
+        }
+
+        /// @brief Offers a value written to the store as a training sample. Sampling stops once enough samples are collected,
+        /// so the training cost stays bounded however long training is put off
+        /// @return true if enough samples are collected and trainStep() or train() should be called
+        bool offer(const char* value, size_t size) {
+            if (!enabled() || size < DICT_MIN_SIZE_TO_COMPRESS || size > DICT_MAX_VALUE_SIZE) {
+                return false;
+            }
+            if (trainingPending()) {
+                return true;
+            }
+            if (offersUntilSampling) {
+                --offersUntilSampling;
+                return false;
+            }
+            if (numOffered++ % DICT_SAMPLE_INTERVAL == 0) {
+                samples.emplace_back(value, size);
+                sampledBytes += size;
+            }
+            return trainingPending();
+        }
+
+        /// @brief Enough samples are collected or training is in progress
+        bool trainingPending() const noexcept {
+            return trainer || sampledBytes >= dictionarySize * DICT_SAMPLE_SIZE_FACTOR;
+        }
+
+        /// @brief Advances pending training by a bounded step, the trained dictionary becomes current once the last step is done
+        /// @return true if training is not finished yet
+        bool trainStep(size_t budgetBytes = DICT_TRAIN_STEP_BYTES);
+
+        /// @brief Trains a new current dictionary from collected samples (finishing training in progress) at once, the previous one is dropped once no value refers to it
+        /// @return false if samples share too little content to build a dictionary
+        bool train();
+
+        /// @brief Dictionary new values are compressed with, nullptr until the first training
+        const CompressionDictionary* current() const noexcept {
+            return currentDictionary;
+        }
+
+        const CompressionDictionary* find(uint16_t id) const {
+            auto it = dictionaries.find(id);
+            return it != dictionaries.end() ? &it->second.dictionary : nullptr;
+        }
+
+        /// @brief Registers a stored value compressed with the dictionary
+        void acquire(uint16_t id) {
+            auto it = dictionaries.find(id);
+            if (it != dictionaries.end()) {
+                ++it->second.refs;
+            }
+        }
+
+        /// @brief Unregisters a stored value, dictionary which is not current anymore is dropped with its last value
+        void release(uint16_t id) {
+            auto it = dictionaries.find(id);
+            if (it == dictionaries.end()) {
+                return;
+            }
+            if (--it->second.refs == 0 && &it->second.dictionary != currentDictionary) {
+                dictionaries.erase(it);
+            }
+        }
+
+        /// @brief Number of dictionaries kept, the current one and older ones still referred to
+        size_t size() const noexcept {
+            return dictionaries.size();
+        }
+
+        /// @brief Bytes of samples collected for the next training
+        size_t getSampledBytes() const noexcept {
+            return sampledBytes;
+        }
+
+        uint64_t getNumTrained() const noexcept {
+            return numTrained;
+        }
+};
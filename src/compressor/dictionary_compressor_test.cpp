@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <random>
+#include "dictionary_compressor.hpp"
+#include "codec.hpp"
+
+namespace {
+    // Small JSON documents with the same structure and varying values, like cached API responses
+    std::vector<std::string> makeValues(size_t count, uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::vector<std::string> values;
+        for (size_t i = 0; i < count; ++i) {
+            values.push_back("{\"coord\":{\"lon\":" + std::to_string(rng() % 180) + ",\"lat\":" + std::to_string(rng() % 90)
+                + "},\"weather\":[{\"id\":" + std::to_string(800 + rng() % 5) + ",\"main\":\"Clouds\",\"description\":\"overcast clouds\",\"icon\":\"04d\"}]"
+                + ",\"main\":{\"temp\":" + std::to_string(rng() % 40) + "." + std::to_string(rng() % 100) + ",\"feels_like\":" + std::to_string(rng() % 40)
+                + ",\"pressure\":" + std::to_string(990 + rng() % 40) + ",\"humidity\":" + std::to_string(rng() % 100) + "},\"visibility\":10000"
+                + ",\"wind\":{\"speed\":" + std::to_string(rng() % 20) + ",\"deg\":" + std::to_string(rng() % 360) + "},\"name\":\"London\",\"cod\":200}");
+        }
+        return values;
+    }
+}
+
+// Test that a trained dictionary round trips values and compresses small values much better than gzip alone
+TEST(DictionaryCompressorTest, TrainCompressDecompress) {
+    CompressionDictionary dictionary { 7, DictionaryCompressor::Train(makeValues(200, 1), DICT_DEFAULT_SIZE) };
+    ASSERT_FALSE(dictionary.data.empty());
+    ASSERT_LE(dictionary.data.size(), DICT_DEFAULT_SIZE);
+
+    size_t plainBytes = 0, gzipBytes = 0, dictionaryBytes = 0;
+    for (auto& value : makeValues(100, 2)) {
+        auto compressed = DictionaryCompressor::Compress(value.data(), value.size(), dictionary);
+        ASSERT_EQ(compressed.operationResult, OPERATION_SUCCESS);
+        ASSERT_EQ(DictionaryCompressor::DictionaryId(compressed.data), 7);
+        auto decompressed = DictionaryCompressor::Decompress(compressed.data, compressed.size, dictionary);
+        ASSERT_EQ(decompressed.operationResult, OPERATION_SUCCESS);
+        ASSERT_EQ(std::string(decompressed.data, decompressed.size), value);
+        ASSERT_EQ(decompressed.data[decompressed.size], '\0');
+
+        auto gzip = GzipCompressor::Compress(value.data(), value.size());
+        plainBytes += value.size();
+        gzipBytes += gzip.size;
+        dictionaryBytes += compressed.size;
+        delete[] gzip.data;
+        delete[] compressed.data;
+        delete[] decompressed.data;
+    }
+    ASSERT_LT(dictionaryBytes * 2, gzipBytes);
+    ASSERT_LT(dictionaryBytes * 4, plainBytes);
+}
+
+// Test that data is rejected with another dictionary, when truncated or without a dictionary
+TEST(DictionaryCompressorTest, DecompressInvalidData) {
+    CompressionDictionary dictionary { 1, DictionaryCompressor::Train(makeValues(200, 1), 4096) };
+    CompressionDictionary other { 2, dictionary.data };
+    auto value = makeValues(1, 3).front();
+    auto compressed = DictionaryCompressor::Compress(value.data(), value.size(), dictionary);
+    ASSERT_EQ(compressed.operationResult, OPERATION_SUCCESS);
+
+    ASSERT_EQ(DictionaryCompressor::Decompress(compressed.data, compressed.size, other).operationResult, DICT_MISSING);
+    auto truncated = DictionaryCompressor::Decompress(compressed.data, compressed.size - 2, dictionary);
+    ASSERT_EQ(truncated.data, nullptr);
+    ASSERT_NE(truncated.operationResult, OPERATION_SUCCESS);
+    ASSERT_EQ(ValueCodec::Decompress(CodecId::DeflateDict, compressed.data, compressed.size).operationResult, DICT_MISSING);
+    ASSERT_EQ(DictionaryCompressor::Decompress(compressed.data, DICT_HEADER_SIZE, dictionary).operationResult, INVALID_INPUT);
+    delete[] compressed.data;
+}
+
+// Test sampling, training at once and in steps, and that a replaced dictionary is kept until its last value is released
+TEST(DictionaryCompressorTest, DictionarySetLifecycle) {
+    DictionarySet disabled;
+    ASSERT_FALSE(disabled.offer("{\"some\":\"value\",\"more\":1}", 26));
+
+    DictionarySet dictionaries(1024);
+    ASSERT_EQ(dictionaries.current(), nullptr);
+    bool pending = false;
+    for (auto& value : makeValues(1000, 4)) {
+        pending = dictionaries.offer(value.data(), value.size());
+        if (pending) break;
+    }
+    ASSERT_TRUE(pending);
+    // Sampling stops until the pending training runs, however many values are written meanwhile
+    auto sampledBytes = dictionaries.getSampledBytes();
+    ASSERT_LT(sampledBytes, 1024 * DICT_SAMPLE_SIZE_FACTOR + DICT_MAX_VALUE_SIZE);
+    for (auto& value : makeValues(1000, 7)) {
+        ASSERT_TRUE(dictionaries.offer(value.data(), value.size()));
+    }
+    ASSERT_EQ(dictionaries.getSampledBytes(), sampledBytes);
+    ASSERT_TRUE(dictionaries.train());
+    ASSERT_FALSE(dictionaries.trainingPending());
+    auto first = dictionaries.current();
+    ASSERT_NE(first, nullptr);
+    auto firstId = first->id;
+    dictionaries.acquire(firstId);
+
+    // Next samples are collected after DICT_RETRAIN_INTERVAL offers only
+    ASSERT_FALSE(dictionaries.offer(makeValues(1, 5).front().data(), 300));
+    auto values = makeValues(200, 6);
+    for (size_t i = 0; i < DICT_RETRAIN_INTERVAL; ++i) {
+        dictionaries.offer(values[i % values.size()].data(), values[i % values.size()].size());
+    }
+    while (!dictionaries.trainingPending()) {
+        for (auto& value : values) {
+            dictionaries.offer(value.data(), value.size());
+        }
+    }
+    // Step by step training keeps the current dictionary until the last step
+    size_t steps = 1;
+    for (; dictionaries.trainStep(1024); ++steps) {
+        ASSERT_EQ(dictionaries.current(), first);
+        ASSERT_TRUE(dictionaries.trainingPending());
+    }
+    ASSERT_GT(steps, 2);
+    ASSERT_FALSE(dictionaries.trainingPending());
+    ASSERT_NE(dictionaries.current()->id, firstId);
+    ASSERT_EQ(dictionaries.size(), 2);
+    ASSERT_NE(dictionaries.find(firstId), nullptr);
+
+    dictionaries.release(firstId);
+    ASSERT_EQ(dictionaries.size(), 1);
+    ASSERT_EQ(dictionaries.find(firstId), nullptr);
+    ASSERT_EQ(dictionaries.getNumTrained(), 2);
+}
@@ -1,112 +1,136 @@
 #include "gzip_compressor.hpp"
 
-CompressResult GzipCompressor::Compress(const char* input) {
-    if (!input || *input == '\0') return { nullptr, 0, INVALID_INPUT };
+namespace {
+    /// @brief zlib streams of the calling thread, created on first use and reset for every next operation
+    struct ThreadStreams {
+        z_stream deflater{};
+        z_stream inflater{};
+        bool deflaterReady = false;
+        bool inflaterReady = false;
+        int deflaterLevel = 0;
+
+        ~ThreadStreams() {
+            if (deflaterReady) {
+                deflateEnd(&deflater);
+            }
+            if (inflaterReady) {
+                inflateEnd(&inflater);
+            }
+        }
+    };
 
-    auto input_length = strlen(input);
-    z_stream strm{};
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    strm.opaque = Z_NULL;
+    thread_local ThreadStreams streams;
 
-    auto operationResult = deflateInit2(&strm, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
-    
-    if (operationResult != Z_OK) {
-        return { nullptr, 0, operationResult };
+    int acquireDeflater(int level) {
+        if (streams.deflaterReady && streams.deflaterLevel == level) {
+            return deflateReset(&streams.deflater);
+        }
+        if (streams.deflaterReady) {
+            deflateEnd(&streams.deflater);
+            streams.deflaterReady = false;
+        }
+        streams.deflater = z_stream{};
+        auto operationResult = deflateInit2(&streams.deflater, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+        if (operationResult == Z_OK) {
+            streams.deflaterReady = true;
+            streams.deflaterLevel = level;
+        }
+        return operationResult;
     }
 
-    strm.avail_in = static_cast<uInt>(input_length);
-    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+    int acquireInflater() {
+        if (streams.inflaterReady) {
+            return inflateReset(&streams.inflater);
+        }
+        streams.inflater = z_stream{};
+        auto operationResult = inflateInit2(&streams.inflater, 15 + 16);
+        streams.inflaterReady = operationResult == Z_OK;
+        return operationResult;
+    }
+}
 
-    size_t buffer_size = CHUNK_SIZE;
-    
-    auto output = new char[buffer_size];
-    size_t total_size = 0;
+CompressResult GzipCompressor::Compress(const char* input, int level) {
+    if (!input) return { nullptr, 0, INVALID_INPUT };
+    return Compress(input, strlen(input), level);
+}
 
-    do {
-        if (total_size + CHUNK_SIZE > buffer_size) {
-            buffer_size *= 2;
-            auto new_output = new char[buffer_size];
-            memcpy(new_output, output, total_size);
-            delete[] output;
-            output = new_output;
-        }
+CompressResult GzipCompressor::Compress(const char* input, size_t input_length, int level) {
+    if (!input || input_length == 0) return { nullptr, 0, INVALID_INPUT };
 
-        strm.avail_out = CHUNK_SIZE;
-        strm.next_out = reinterpret_cast<Bytef*>(output + total_size);
+    auto operationResult = acquireDeflater(level);
+    if (operationResult != Z_OK) {
+        return { nullptr, 0, operationResult };
+    }
+    auto& strm = streams.deflater;
 
-        operationResult = deflate(&strm, Z_FINISH);
-        total_size += (CHUNK_SIZE - strm.avail_out);
-    } while (strm.avail_out == 0);
+    // Bound covers the gzip wrapper too, so the whole input is compressed by a single deflate call
+    auto buffer_size = deflateBound(&strm, static_cast<uLong>(input_length));
+    auto output = new char[buffer_size];
 
-    deflateEnd(&strm);
+    strm.avail_in = static_cast<uInt>(input_length);
+    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+    strm.avail_out = static_cast<uInt>(buffer_size);
+    strm.next_out = reinterpret_cast<Bytef*>(output);
 
+    operationResult = deflate(&strm, Z_FINISH);
     if (operationResult != Z_STREAM_END) {
         delete[] output;
         return { nullptr, 0, operationResult };
     }
 
-    return { output, total_size, OPERATION_SUCCESS };
+    return { output, static_cast<size_t>(strm.total_out), OPERATION_SUCCESS };
 }
 
 DecompressResult GzipCompressor::Decompress(const char* input, size_t input_size) {
-    if (!input || input_size == 0) return { nullptr, INVALID_INPUT };
+    if (!input || input_size == 0) return { nullptr, 0, INVALID_INPUT };
 
-    z_stream strm{};
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    strm.opaque = Z_NULL;
+    auto operationResult = acquireInflater();
+    if (operationResult != Z_OK) {
+        return { nullptr, 0, operationResult };
+    }
+    auto& strm = streams.inflater;
     strm.avail_in = static_cast<uInt>(input_size);
     strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
 
-    auto operationResult = inflateInit2(&strm, 15 + 16);
-    if (operationResult != Z_OK) {
-        return { nullptr, operationResult };
+    // Gzip trailer ends with the uncompressed size (mod 2^32), it sizes the output exactly for values we produce
+    size_t expected_size = CHUNK_SIZE;
+    if (input_size >= 4) {
+        auto trailer = reinterpret_cast<const unsigned char*>(input + input_size - 4);
+        expected_size = static_cast<size_t>(trailer[0]) | (static_cast<size_t>(trailer[1]) << 8)
+                      | (static_cast<size_t>(trailer[2]) << 16) | (static_cast<size_t>(trailer[3]) << 24);
     }
 
-    size_t buffer_size = CHUNK_SIZE;
+    size_t buffer_size = expected_size + 1;
     auto output = new char[buffer_size];
     size_t total_size = 0;
 
-    do {
-        if (total_size + CHUNK_SIZE > buffer_size) {
-            buffer_size *= 2;
+    while (true) {
+        if (total_size + 1 == buffer_size) {
+            // Trailer lied (corrupted or >4GB value), fall back to growing the buffer
+            buffer_size = buffer_size * 2 + CHUNK_SIZE;
             auto new_output = new char[buffer_size];
             memcpy(new_output, output, total_size);
             delete[] output;
             output = new_output;
         }
 
-        strm.avail_out = CHUNK_SIZE;
+        strm.avail_out = static_cast<uInt>(buffer_size - 1 - total_size);
         strm.next_out = reinterpret_cast<Bytef*>(output + total_size);
 
+        auto avail_before = strm.avail_out;
         operationResult = inflate(&strm, Z_NO_FLUSH);
-        total_size += (CHUNK_SIZE - strm.avail_out);
+        total_size += avail_before - strm.avail_out;
 
-        if (operationResult == Z_STREAM_ERROR) {
-            inflateEnd(&strm);
-            delete[] output;
-            return { nullptr, operationResult };
+        if (operationResult == Z_STREAM_END) {
+            break;
         }
-        if (operationResult == Z_DATA_ERROR) {
-            inflateEnd(&strm);
+        if ((operationResult != Z_OK && operationResult != Z_BUF_ERROR) || (strm.avail_out != 0 && strm.avail_in == 0)) {
+            // Either broken stream or truncated input, which can not make progress anymore
             delete[] output;
-            return { nullptr, operationResult };
+            return { nullptr, 0, operationResult == Z_OK ? Z_BUF_ERROR : operationResult };
         }
-    } while (operationResult != Z_STREAM_END);
-
-    inflateEnd(&strm);
-
-    if (operationResult != Z_STREAM_END) {
-        delete[] output;
-        return { nullptr, operationResult };
     }
 
-    char* decompressed = new char[total_size + 1];
-    std::memcpy(decompressed, output, total_size);
-    decompressed[total_size] = '\0';
-    delete[] output;
-
-    return { decompressed, OPERATION_SUCCESS };
+    output[total_size] = '\0';
+    return { output, total_size, OPERATION_SUCCESS };
 }
-
@@ -9,6 +9,8 @@
 
 #define CHUNK_SIZE 16384  // Buffer size for zlib operations
 #define INVALID_INPUT -999
+/// @brief zlib level used when none is given, favours speed over ratio which is close to Z_BEST_COMPRESSION for typical values anyway
+#define GZIP_DEFAULT_LEVEL 6
 #define OPERATION_SUCCESS 0
 
 
@@ -26,20 +28,31 @@ struct CompressResult {
 struct DecompressResult {
     /// @brief Pointer to decompressed string data location
     char* data;
+    /// @brief Size of data, not including zero terminator
+    size_t size;
     /// @brief Return code of underlying zlib execution, 0 - on success, -999 on invalid input, non zero on error. Check complete list of result codes here: https://www.zlib.net/manual.html
     int operationResult;
 };
 
+/// @brief Gzip compression with zlib streams kept per thread: streams are initialized once and reset between calls instead of allocating zlib state every time
 class GzipCompressor {
     public:
         /// @brief Performs gzip compression for the input string, you are responsible to delete[] the memory or capture it with smart pointer!
         /// @param input Input string
+        /// @param level zlib compression level, 0-9 or Z_DEFAULT_COMPRESSION
         /// @return Pointer to compressed string on success, nullptr on error
-        static CompressResult Compress(const char* input);
+        static CompressResult Compress(const char* input, int level = GZIP_DEFAULT_LEVEL);
+
+        /// @brief Performs gzip compression for the first length bytes of input, input may contain zero bytes. You are responsible to delete[] the memory or capture it with smart pointer!
+        /// @param input Input data
+        /// @param length Input data size
+        /// @param level zlib compression level, 0-9 or Z_DEFAULT_COMPRESSION
+        /// @return Pointer to compressed data on success, nullptr on error
+        static CompressResult Compress(const char* input, size_t length, int level = GZIP_DEFAULT_LEVEL);
 
         /// @brief Performs gzip decompression for the input string, you are responsible to delete[] the memory or capture it with smart pointer!
         /// @param input Compressed string
-        /// @return Pointer to decompressed string on success, nullptr on error
+        /// @return Pointer to decompressed data on success (zero terminated, size does not include terminator), nullptr on error
         static DecompressResult Decompress(const char* input, size_t input_size);
 };
 
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include <zlib.h>
+#include <string>
 #include "gzip_compressor.hpp"
 
 // Test compression and decompression of a normal string
@@ -70,6 +71,26 @@ TEST(GzipCompressorTest, CompressDecompressLongString) {
     delete[] decompressed.data;
 }
 
+// Test compressing data with embedded zero bytes
+TEST(GzipCompressorTest, CompressDecompressBinaryData) {
+    std::string input(100, '\0');
+    input += "payload";
+    input += std::string(100, '\0');
+
+    auto compressed = GzipCompressor::Compress(input.data(), input.size());
+    ASSERT_NE(compressed.data, nullptr) << "Compression failed.";
+    ASSERT_EQ(compressed.operationResult, OPERATION_SUCCESS) << "Compression failed.";
+
+    auto decompressed = GzipCompressor::Decompress(compressed.data, compressed.size);
+    ASSERT_NE(decompressed.data, nullptr) << "Decompression failed.";
+    ASSERT_EQ(decompressed.operationResult, OPERATION_SUCCESS) << "Decompression failed.";
+    ASSERT_EQ(decompressed.size, input.size());
+    EXPECT_EQ(std::string(decompressed.data, decompressed.size), input) << "Decompressed data does not match original.";
+
+    delete[] compressed.data;
+    delete[] decompressed.data;
+}
+
 // Test compression efficiency (compressed size should be smaller than original)
 TEST(GzipCompressorTest, CompressionReducesSize) {
     auto input = "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
@@ -94,3 +115,35 @@ TEST(GzipCompressorTest, DecompressInvalidData) {
     ASSERT_LT(decompressed.operationResult, OPERATION_SUCCESS) << "Decompression of invalid data should return negative result.";
 }
 
+
+// Test that per-thread streams are reused across levels, inputs of different sizes and failed operations
+TEST(GzipCompressorTest, ReuseStreamsAcrossLevels) {
+    std::string input;
+    for (int i = 0; i < 5000; ++i) {
+        input += "value-" + std::to_string(i % 97) + ";";
+    }
+    size_t previousSize = 0;
+    for (int level : {1, 6, 9, Z_DEFAULT_COMPRESSION, 0}) {
+        for (size_t length : {size_t(1), size_t(100), input.size()}) {
+            auto compressed = GzipCompressor::Compress(input.data(), length, level);
+            ASSERT_EQ(compressed.operationResult, OPERATION_SUCCESS) << "level = " << level;
+            auto decompressed = GzipCompressor::Decompress(compressed.data, compressed.size);
+            ASSERT_EQ(decompressed.operationResult, OPERATION_SUCCESS) << "level = " << level;
+            ASSERT_EQ(std::string(decompressed.data, decompressed.size), input.substr(0, length));
+            if (length == input.size() && level == 0) {
+                ASSERT_GT(compressed.size, previousSize);
+            }
+            if (length == input.size()) {
+                previousSize = compressed.size;
+            }
+
+            // Truncated stream must fail without breaking the next call
+            auto truncated = GzipCompressor::Decompress(compressed.data, compressed.size / 2);
+            ASSERT_EQ(truncated.data, nullptr);
+            ASSERT_NE(truncated.operationResult, OPERATION_SUCCESS);
+
+            delete[] compressed.data;
+            delete[] decompressed.data;
+        }
+    }
+}
@@ -0,0 +1,181 @@
+#include "lz4_compressor.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace {
+    constexpr size_t MIN_MATCH = 4;
+    /// @brief Block format requires the last 5 bytes to be literals and the last match to start at least 12 bytes before the end
+    constexpr size_t LAST_LITERALS = 5;
+    constexpr size_t MF_LIMIT = 12;
+    constexpr size_t MAX_DISTANCE = 65535;
+    /// @brief Skip speed grows every 2^SKIP_TRIGGER bytes without a match, so incompressible data is passed quickly
+    constexpr size_t SKIP_TRIGGER = 6;
+
+    inline uint32_t read32(const unsigned char* p) noexcept {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t hashOf(uint32_t sequence, int hashLog) noexcept {
+        return (sequence * 2654435761u) >> (32 - hashLog);
+    }
+
+    inline unsigned char* writeLength(unsigned char* op, size_t length) noexcept {
+        for (; length >= 255; length -= 255) {
+            *op++ = 255;
+        }
+        *op++ = static_cast<unsigned char>(length);
+        return op;
+    }
+
+    unsigned char* writeSequence(unsigned char* op, const unsigned char* literals, size_t literalLength, size_t offset, size_t matchLength) noexcept {
+        auto* token = op++;
+        *token = static_cast<unsigned char>(std::min<size_t>(literalLength, 15) << 4);
+        if (literalLength >= 15) {
+            op = writeLength(op, literalLength - 15);
+        }
+        memcpy(op, literals, literalLength);
+        op += literalLength;
+        if (matchLength == 0) {
+            return op;
+        }
+
+        *op++ = static_cast<unsigned char>(offset);
+        *op++ = static_cast<unsigned char>(offset >> 8);
+        auto extraLength = matchLength - MIN_MATCH;
+        *token |= static_cast<unsigned char>(std::min<size_t>(extraLength, 15));
+        if (extraLength >= 15) {
+            op = writeLength(op, extraLength - 15);
+        }
+        return op;
+    }
+
+    inline bool readLength(const unsigned char*& ip, const unsigned char* end, size_t& length) noexcept {
+        unsigned char byte;
+        do {
+            if (ip >= end) return false;
+            byte = *ip++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+}
+
+CompressResult Lz4Compressor::Compress(const char* input, size_t input_length) {
+    if (!input || input_length == 0 || input_length > UINT32_MAX) return { nullptr, 0, INVALID_INPUT };
+
+    auto output = new char[CompressBound(input_length)];
+    auto* out = reinterpret_cast<unsigned char*>(output);
+    for (size_t i = 0; i < LZ4_SIZE_PREFIX; ++i) {
+        out[i] = static_cast<unsigned char>(input_length >> (8 * i));
+    }
+    auto* op = out + LZ4_SIZE_PREFIX;
+
+    const auto* in = reinterpret_cast<const unsigned char*>(input);
+    size_t anchor = 0;
+    if (input_length > MF_LIMIT) {
+        // Small values do not need the whole table, clearing it would cost more than compressing
+        const int hashLog = std::clamp(static_cast<int>(std::bit_width(input_length)), 8, LZ4_HASH_LOG);
+        uint32_t table[1 << LZ4_HASH_LOG];
+        memset(table, 0, sizeof(uint32_t) << hashLog);
+
+        const size_t matchLimit = input_length - LAST_LITERALS;
+        const size_t mfLimit = input_length - MF_LIMIT;
+        size_t ip = 1;
+        table[hashOf(read32(in), hashLog)] = 0;
+
+        while (ip < mfLimit) {
+            auto sequence = read32(in + ip);
+            auto h = hashOf(sequence, hashLog);
+            size_t ref = table[h];
+            table[h] = static_cast<uint32_t>(ip);
+            if (ip - ref > MAX_DISTANCE || read32(in + ref) != sequence) {
+                ip += 1 + ((ip - anchor) >> SKIP_TRIGGER);
+                continue;
+            }
+
+            while (ip > anchor && ref > 0 && in[ip - 1] == in[ref - 1]) {
+                --ip;
+                --ref;
+            }
+            size_t matchLength = MIN_MATCH;
+            while (ip + matchLength < matchLimit && in[ref + matchLength] == in[ip + matchLength]) {
+                ++matchLength;
+            }
+
+            op = writeSequence(op, in + anchor, ip - anchor, ip - ref, matchLength);
+            ip += matchLength;
+            anchor = ip;
+            if (ip < mfLimit) {
+                table[hashOf(read32(in + ip - 2), hashLog)] = static_cast<uint32_t>(ip - 2);
+            }
+        }
+    }
+    op = writeSequence(op, in + anchor, input_length - anchor, 0, 0);
+
+    return { output, static_cast<size_t>(op - out), OPERATION_SUCCESS };
+}
+
+DecompressResult Lz4Compressor::Decompress(const char* input, size_t input_size) {
+    if (!input || input_size <= LZ4_SIZE_PREFIX) return { nullptr, 0, INVALID_INPUT };
+
+    const auto* ip = reinterpret_cast<const unsigned char*>(input);
+    const auto* end = ip + input_size;
+    size_t output_size = 0;
+    for (size_t i = 0; i < LZ4_SIZE_PREFIX; ++i) {
+        output_size |= static_cast<size_t>(ip[i]) << (8 * i);
+    }
+    ip += LZ4_SIZE_PREFIX;
+    // A sequence can not expand to more than 255 bytes per input byte, do not trust the prefix beyond that
+    if (output_size / 255 > input_size) return { nullptr, 0, LZ4_CORRUPTED_INPUT };
+
+    auto output = new char[output_size + 1];
+    auto* out = reinterpret_cast<unsigned char*>(output);
+    size_t op = 0;
+    auto fail = [&]() -> DecompressResult {
+        delete[] output;
+        return { nullptr, 0, LZ4_CORRUPTED_INPUT };
+    };
+
+    while (true) {
+        if (ip >= end) return fail();
+        auto token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(ip, end, literalLength)) return fail();
+        if (literalLength > static_cast<size_t>(end - ip) || literalLength > output_size - op) return fail();
+        memcpy(out + op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        if (ip == end) {
+            break;
+        }
+
+        if (end - ip < 2) return fail();
+        size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) return fail();
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(ip, end, matchLength)) return fail();
+        matchLength += MIN_MATCH;
+        if (matchLength > output_size - op) return fail();
+
+        auto* match = out + op - offset;
+        if (offset >= matchLength) {
+            memcpy(out + op, match, matchLength);
+        } else {
+            // Overlapping match repeats the last offset bytes
+            for (size_t i = 0; i < matchLength; ++i) {
+                out[op + i] = match[i];
+            }
+        }
+        op += matchLength;
+    }
+
+    if (op != output_size) return fail();
+    output[output_size] = '\0';
+    return { output, output_size, OPERATION_SUCCESS };
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include "gzip_compressor.hpp"
+
+/// @brief Decompress result code for a stream which is not a valid LZ4 block
+#define LZ4_CORRUPTED_INPUT -998
+/// @brief Size of the uncompressed length prefix written before the LZ4 block
+#define LZ4_SIZE_PREFIX 4
+/// @brief Max log2 of the match finder hash table (4096 entries), smaller inputs use smaller tables
+#define LZ4_HASH_LOG 12
+
+/// @brief Fast LZ77 compression in the LZ4 block format (greedy single-probe match finder, no entropy coding).
+/// Output is the uncompressed length (4 bytes, little endian) followed by a raw LZ4 block, so it can be decompressed with a single allocation
+class Lz4Compressor {
+    public:
+        /// @brief Compresses the first length bytes of input, input may contain zero bytes. You are responsible to delete[] the memory!
+        /// @return Pointer to compressed data on success, nullptr on error
+        static CompressResult Compress(const char* input, size_t length);
+
+        /// @brief Decompresses data produced by Compress, you are responsible to delete[] the memory!
+        /// @return Pointer to decompressed data on success (zero terminated, size does not include terminator), nullptr on error
+        static DecompressResult Decompress(const char* input, size_t input_size);
+
+        /// @brief Max size of Compress output for length bytes of input
+        static constexpr size_t CompressBound(size_t length) noexcept {
+            return LZ4_SIZE_PREFIX + length + length / 255 + 16;
+        }
+};
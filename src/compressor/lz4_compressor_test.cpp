@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <random>
+#include "lz4_compressor.hpp"
+#include "codec.hpp"
+
+// Test round trip of repetitive, random, short and long inputs
+TEST(Lz4CompressorTest, CompressDecompress) {
+    std::mt19937 rng(42);
+    for (size_t length : {1, 5, 12, 13, 100, 4096, 70000, 200000}) {
+        std::string repetitive, random(length, '\0');
+        for (size_t i = 0; repetitive.size() < length; ++i) {
+            repetitive += "{\"id\":" + std::to_string(i % 50) + "}";
+        }
+        repetitive.resize(length);
+        for (auto& c : random) {
+            c = static_cast<char>(rng());
+        }
+
+        for (auto& input : {repetitive, random}) {
+            auto compressed = Lz4Compressor::Compress(input.data(), input.size());
+            ASSERT_EQ(compressed.operationResult, OPERATION_SUCCESS);
+            ASSERT_LE(compressed.size, Lz4Compressor::CompressBound(input.size()));
+            auto decompressed = Lz4Compressor::Decompress(compressed.data, compressed.size);
+            ASSERT_EQ(decompressed.operationResult, OPERATION_SUCCESS);
+            ASSERT_EQ(std::string(decompressed.data, decompressed.size), input);
+            ASSERT_EQ(decompressed.data[decompressed.size], '\0');
+            delete[] compressed.data;
+            delete[] decompressed.data;
+        }
+
+        if (length >= 4096) {
+            auto compressed = Lz4Compressor::Compress(repetitive.data(), repetitive.size());
+            ASSERT_LT(compressed.size, repetitive.size() / 2);
+            delete[] compressed.data;
+        }
+    }
+}
+
+// Test that corrupted or truncated input is rejected
+TEST(Lz4CompressorTest, DecompressInvalidData) {
+    std::string input(1000, 'a');
+    auto compressed = Lz4Compressor::Compress(input.data(), input.size());
+    ASSERT_EQ(compressed.operationResult, OPERATION_SUCCESS);
+
+    auto truncated = Lz4Compressor::Decompress(compressed.data, compressed.size - 1);
+    ASSERT_EQ(truncated.data, nullptr);
+    ASSERT_EQ(truncated.operationResult, LZ4_CORRUPTED_INPUT);
+
+    std::string wrongSize(compressed.data, compressed.size);
+    wrongSize[0] ^= 1;
+    auto mismatch = Lz4Compressor::Decompress(wrongSize.data(), wrongSize.size());
+    ASSERT_EQ(mismatch.data, nullptr);
+
+    auto invalid = Lz4Compressor::Decompress(nullptr, 10);
+    ASSERT_EQ(invalid.operationResult, INVALID_INPUT);
+    delete[] compressed.data;
+}
+
+// Test dispatch by codec id
+TEST(ValueCodecTest, Dispatch) {
+    std::string input(500, 'z');
+    for (auto codec : {CodecId::Gzip, CodecId::Lz4}) {
+        auto compressed = ValueCodec::Compress(codec, input.data(), input.size());
+        ASSERT_EQ(compressed.operationResult, OPERATION_SUCCESS) << ValueCodec::Name(codec);
+        auto decompressed = ValueCodec::Decompress(codec, compressed.data, compressed.size);
+        ASSERT_EQ(std::string(decompressed.data, decompressed.size), input) << ValueCodec::Name(codec);
+        delete[] compressed.data;
+        delete[] decompressed.data;
+    }
+    ASSERT_EQ(ValueCodec::Compress(CodecId::None, input.data(), input.size()).operationResult, INVALID_INPUT);
+}
+
+// Test that the estimate tells repetitive values from random ones, and base64 is only worth it with an entropy coder
+TEST(ValueCodecTest, EstimateSavings) {
+    std::mt19937 rng(7);
+    const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (size_t length : {200, 1000, 20000}) {
+        std::string repetitive, random(length, '\0'), base64(length, '\0');
+        for (size_t i = 0; repetitive.size() < length; ++i) {
+            repetitive += "{\"id\":" + std::to_string(i % 50) + ",\"name\":\"item\"},";
+        }
+        repetitive.resize(length);
+        for (size_t i = 0; i < length; ++i) {
+            random[i] = static_cast<char>(rng());
+            base64[i] = alphabet[rng() % 64];
+        }
+        for (auto codec : {CodecId::Gzip, CodecId::Lz4}) {
+            ASSERT_GE(ValueCodec::EstimateSavingsPercent(codec, repetitive.data(), length), 50) << ValueCodec::Name(codec) << " " << length;
+            ASSERT_LT(ValueCodec::EstimateSavingsPercent(codec, random.data(), length), 5) << ValueCodec::Name(codec) << " " << length;
+        }
+        ASSERT_LT(ValueCodec::EstimateSavingsPercent(CodecId::Lz4, base64.data(), length), 5) << length;
+        ASSERT_GT(ValueCodec::EstimateSavingsPercent(CodecId::Gzip, base64.data(), length), 10) << length;
+    }
+    ASSERT_EQ(ValueCodec::EstimateSavingsPercent(CodecId::None, alphabet, 64), 0);
+    ASSERT_EQ(ValueCodec::EstimateSavingsPercent(CodecId::Gzip, "aaa", 3), 0);
+}
@@ -1,11 +1,73 @@
 #include "hash.hpp"
+#include <random>
 
+const HashSeed& hashSeed() noexcept {
+    // Seeds differ between processes, so colliding keys found against one instance do not collide on another
+    static const HashSeed seed = [] {
+        std::random_device device;
+        auto next = [&device] { return (static_cast<uint64_t>(device()) << 32) | device(); };
+        return HashSeed { next(), next() };
+    }();
+    return seed;
+}
 
 uint_fast64_t hashFunc(const char *key) {
-    uint_fast64_t len = strlen(key);
-    uint_fast64_t hash_otpt[2];
-    MurmurHash3_x64_128(key, len, 0, &hash_otpt); //TODO, generate random seed once on runtime
-    return hash_otpt[0];
+    return hashFunc(key, strlen(key));
+}
+
+uint_fast64_t hashFunc(const char *key, size_t len) {
+    return HashPolicy::hash(key, len, hashSeed());
+}
+
+void hashFuncBatch(const std::string_view *keys, size_t count, uint_fast64_t *hashes) {
+    HashPolicy::hashBatch(keys, count, hashSeed(), hashes);
+}
+
+/// @brief Input words of wyhash for keys up to 16 bytes
+static inline void wyhashShortInput(const uint8_t *p, size_t len, uint64_t &a, uint64_t &b) noexcept {
+    if (len >= 4) {
+        a = (_wyr4(p) << 32) | _wyr4(p + ((len >> 3) << 2));
+        b = (_wyr4(p + len - 4) << 32) | _wyr4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+        a = _wyr3(p, len);
+        b = 0;
+    } else {
+        a = b = 0;
+    }
+}
+
+void WyHashPolicy::hashBatch(const std::string_view *keys, size_t count, const HashSeed &seed, uint_fast64_t *hashes) noexcept {
+    // Seed mixing does not depend on the key, so it is done once per batch
+    const uint64_t mixedSeed = seed.k0 ^ _wymix(seed.k0 ^ _wyp[0], _wyp[1]);
+    size_t i = 0;
+    for (; i + HASH_BATCH_LANES <= count; i += HASH_BATCH_LANES) {
+        bool allShort = true;
+        for (size_t lane = 0; lane < HASH_BATCH_LANES; ++lane) {
+            allShort &= keys[i + lane].size() <= 16;
+        }
+        if (!allShort) {
+            for (size_t lane = 0; lane < HASH_BATCH_LANES; ++lane) {
+                hashes[i + lane] = hash(keys[i + lane].data(), keys[i + lane].size(), seed);
+            }
+            continue;
+        }
+
+        uint64_t a[HASH_BATCH_LANES], b[HASH_BATCH_LANES];
+        for (size_t lane = 0; lane < HASH_BATCH_LANES; ++lane) {
+            wyhashShortInput(reinterpret_cast<const uint8_t*>(keys[i + lane].data()), keys[i + lane].size(), a[lane], b[lane]);
+        }
+        for (size_t lane = 0; lane < HASH_BATCH_LANES; ++lane) {
+            a[lane] ^= _wyp[1];
+            b[lane] ^= mixedSeed;
+            _wymum(&a[lane], &b[lane]);
+        }
+        for (size_t lane = 0; lane < HASH_BATCH_LANES; ++lane) {
+            hashes[i + lane] = _wymix(a[lane] ^ _wyp[0] ^ keys[i + lane].size(), b[lane] ^ _wyp[1]);
+        }
+    }
+    for (; i < count; ++i) {
+        hashes[i] = hash(keys[i].data(), keys[i].size(), seed);
+    }
 }
 
 
@@ -18,4 +80,4 @@ uint_fast64_t hashFunc(const char *key) {
         hash ^= hash >> 47;
     }
     return hash;
-}*/
\ No newline at end of file
+}*/
@@ -1,6 +1,90 @@
 #pragma once
 #include <cstdint>
 #include <cstring>
+#include <string_view>
 #include "MurmurHash3.h"
+#include "wyhash.h"
+#include "siphash.h"
+
+/// @brief Fast 64-bit hash, default
+#define HASH_POLICY_WYHASH 1
+/// @brief Keyed SipHash-1-3, slower but resistant to hash flooding by clients which can not learn the process seed
+#define HASH_POLICY_SIPHASH 2
+/// @brief Previous default, 128-bit MurmurHash3 truncated to 64 bits
+#define HASH_POLICY_MURMUR3 3
+
+#ifndef HASH_POLICY
+#define HASH_POLICY HASH_POLICY_WYHASH
+#endif
+
+/// @brief Number of hash bits used to pick a shard, they are taken from the middle of the hash:
+/// bucket index uses the low bits and control byte tag uses the top 7 bits, so shard choice does not bias bucket choice
+#define SHARD_HASH_BITS 25
+#define SHARD_HASH_SHIFT 32
+
+/// @brief Number of keys hashed side by side by hashFuncBatch
+#define HASH_BATCH_LANES 4
+
+/// @brief Random key of the process, generated once on first use
+struct HashSeed {
+    uint64_t k0;
+    uint64_t k1;
+};
+
+const HashSeed& hashSeed() noexcept;
+
+struct WyHashPolicy {
+    static uint_fast64_t hash(const char *key, size_t len, const HashSeed &seed) noexcept {
+        return wyhash(key, len, seed.k0, _wyp);
+    }
+
+    /// @brief Hashes short keys in HASH_BATCH_LANES interleaved lanes, so their 128-bit multiplies overlap instead of forming one dependency chain
+    static void hashBatch(const std::string_view *keys, size_t count, const HashSeed &seed, uint_fast64_t *hashes) noexcept;
+};
+
+struct SipHashPolicy {
+    static uint_fast64_t hash(const char *key, size_t len, const HashSeed &seed) noexcept {
+        return siphash<1, 3>(key, len, seed.k0, seed.k1);
+    }
+
+    static void hashBatch(const std::string_view *keys, size_t count, const HashSeed &seed, uint_fast64_t *hashes) noexcept {
+        for (size_t i = 0; i < count; ++i) {
+            hashes[i] = hash(keys[i].data(), keys[i].size(), seed);
+        }
+    }
+};
+
+struct Murmur3Policy {
+    static uint_fast64_t hash(const char *key, size_t len, const HashSeed &seed) noexcept {
+        uint_fast64_t hash_otpt[2];
+        MurmurHash3_x64_128(key, static_cast<int>(len), static_cast<uint32_t>(seed.k0), &hash_otpt);
+        return hash_otpt[0];
+    }
+
+    static void hashBatch(const std::string_view *keys, size_t count, const HashSeed &seed, uint_fast64_t *hashes) noexcept {
+        for (size_t i = 0; i < count; ++i) {
+            hashes[i] = hash(keys[i].data(), keys[i].size(), seed);
+        }
+    }
+};
+
+#if HASH_POLICY == HASH_POLICY_WYHASH
+using HashPolicy = WyHashPolicy;
+#elif HASH_POLICY == HASH_POLICY_SIPHASH
+using HashPolicy = SipHashPolicy;
+#elif HASH_POLICY == HASH_POLICY_MURMUR3
+using HashPolicy = Murmur3Policy;
+#else
+#error "Unknown HASH_POLICY"
+#endif
 
 uint_fast64_t hashFunc(const char *key);
+uint_fast64_t hashFunc(const char *key, size_t len);
+/// @brief Hashes count keys at once, every result is equal to hashFunc of the same key
+void hashFuncBatch(const std::string_view *keys, size_t count, uint_fast64_t *hashes);
+
+/// @brief Maps hash to [0, numShards) with Lemire's fast range reduction (multiply and shift instead of division)
+inline uint_fast32_t shardIndex(uint_fast64_t hash, uint_fast32_t numShards) noexcept {
+    auto bits = (hash >> SHARD_HASH_SHIFT) & ((uint_fast64_t(1) << SHARD_HASH_BITS) - 1);
+    return static_cast<uint_fast32_t>((bits * numShards) >> SHARD_HASH_BITS);
+}
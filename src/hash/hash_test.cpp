@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <set>
+#include "hash.hpp"
+
+// Reference vectors of SipHash-2-4 (key 00..0f, message 00..len-1) validate the shared SipHash core
+TEST(HashTest, SipHashReferenceVectors) {
+    uint8_t keyBytes[16], message[16];
+    for (int i = 0; i < 16; ++i) {
+        keyBytes[i] = static_cast<uint8_t>(i);
+        message[i] = static_cast<uint8_t>(i);
+    }
+    uint64_t k0, k1;
+    memcpy(&k0, keyBytes, 8);
+    memcpy(&k1, keyBytes + 8, 8);
+    ASSERT_EQ((siphash<2, 4>(message, 0, k0, k1)), 0x726fdb47dd0e0e31ull);
+    ASSERT_EQ((siphash<2, 4>(message, 1, k0, k1)), 0x74f839c593dc67fdull);
+    ASSERT_EQ((siphash<2, 4>(message, 15, k0, k1)), 0xa129ca6149be45e5ull);
+}
+
+TEST(HashTest, WyHashReferenceVectors) {
+    ASSERT_EQ(wyhash("", 0, 0, _wyp), 0x93228a4de0eec5a2ull);
+    ASSERT_EQ(wyhash("a", 1, 1, _wyp), 0xc5bac3db178713c4ull);
+}
+
+// Every policy must depend on all key bytes (including zeros) and on the seed
+template<typename Policy>
+void checkPolicy() {
+    HashSeed seed { 1, 2 }, otherSeed { 3, 4 };
+    std::set<uint_fast64_t> hashes;
+    std::string key;
+    for (int len = 0; len < 100; ++len) {
+        ASSERT_EQ(Policy::hash(key.data(), key.size(), seed), Policy::hash(key.data(), key.size(), seed));
+        ASSERT_NE(Policy::hash(key.data(), key.size(), seed), Policy::hash(key.data(), key.size(), otherSeed));
+        hashes.insert(Policy::hash(key.data(), key.size(), seed));
+        key.push_back(len % 2 ? 'k' : '\0');
+    }
+    ASSERT_EQ(hashes.size(), 100u);
+}
+
+TEST(HashTest, Policies) {
+    checkPolicy<WyHashPolicy>();
+    checkPolicy<SipHashPolicy>();
+    checkPolicy<Murmur3Policy>();
+}
+
+TEST(HashTest, ProcessSeed) {
+    ASSERT_EQ(&hashSeed(), &hashSeed());
+    ASSERT_EQ(hashFunc("key"), hashFunc("key", 3));
+    ASSERT_EQ(hashFunc("key"), HashPolicy::hash("key", 3, hashSeed()));
+}
+
+// Batch hashing must give exactly the same hashes as hashing keys one by one
+TEST(HashTest, BatchMatchesSingleKey) {
+    std::vector<std::string> storage;
+    for (int i = 0; i < 203; ++i) {
+        storage.push_back(std::string(i % 41, static_cast<char>('a' + i % 26)) + std::to_string(i));
+    }
+    storage.push_back("");
+    std::vector<std::string_view> keys(storage.begin(), storage.end());
+    std::vector<uint_fast64_t> hashes(keys.size());
+    hashFuncBatch(keys.data(), keys.size(), hashes.data());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_EQ(hashes[i], hashFunc(keys[i].data(), keys[i].size())) << "key = " << keys[i];
+    }
+
+    HashSeed seed { 5, 6 };
+    SipHashPolicy::hashBatch(keys.data(), keys.size(), seed, hashes.data());
+    ASSERT_EQ(hashes[7], SipHashPolicy::hash(keys[7].data(), keys[7].size(), seed));
+}
+
+TEST(HashTest, ShardIndex) {
+    const uint_fast32_t numShards = 24;
+    std::vector<int> counts(numShards);
+    for (int i = 0; i < 240000; ++i) {
+        auto key = "key:" + std::to_string(i);
+        auto shard = shardIndex(hashFunc(key.data(), key.size()), numShards);
+        ASSERT_LT(shard, numShards);
+        ++counts[shard];
+    }
+    for (auto count : counts) {
+        ASSERT_GT(count, 9000);
+        ASSERT_LT(count, 11000);
+    }
+}
@@ -0,0 +1,60 @@
+// SipHash by Jean-Philippe Aumasson and Daniel J. Bernstein, keyed hash resistant to hash flooding.
+// Written after the reference implementation (CC0), C compression and D finalization rounds are template parameters.
+
+#ifndef _SIPHASH_H_
+#define _SIPHASH_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define _SIP_ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define _SIP_ROUND                                                              \
+    do {                                                                        \
+        v0 += v1; v1 = _SIP_ROTL(v1, 13); v1 ^= v0; v0 = _SIP_ROTL(v0, 32);     \
+        v2 += v3; v3 = _SIP_ROTL(v3, 16); v3 ^= v2;                             \
+        v0 += v3; v3 = _SIP_ROTL(v3, 21); v3 ^= v0;                             \
+        v2 += v1; v1 = _SIP_ROTL(v1, 17); v1 ^= v2; v2 = _SIP_ROTL(v2, 32);     \
+    } while (0)
+
+template<int C, int D>
+inline uint64_t siphash(const void *key, size_t len, uint64_t k0, uint64_t k1) {
+    const uint8_t *p = (const uint8_t *)key;
+    uint64_t v0 = 0x736f6d6570736575ull ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dull ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ull ^ k0;
+    uint64_t v3 = 0x7465646279746573ull ^ k1;
+
+    const uint8_t *end = p + len - (len % 8);
+    for (; p != end; p += 8) {
+        uint64_t m;
+        memcpy(&m, p, 8);
+        v3 ^= m;
+        for (int i = 0; i < C; ++i) _SIP_ROUND;
+        v0 ^= m;
+    }
+
+    uint64_t b = ((uint64_t)len) << 56;
+    switch (len & 7) {
+        case 7: b |= ((uint64_t)p[6]) << 48; [[fallthrough]];
+        case 6: b |= ((uint64_t)p[5]) << 40; [[fallthrough]];
+        case 5: b |= ((uint64_t)p[4]) << 32; [[fallthrough]];
+        case 4: b |= ((uint64_t)p[3]) << 24; [[fallthrough]];
+        case 3: b |= ((uint64_t)p[2]) << 16; [[fallthrough]];
+        case 2: b |= ((uint64_t)p[1]) << 8; [[fallthrough]];
+        case 1: b |= ((uint64_t)p[0]); break;
+        case 0: break;
+    }
+
+    v3 ^= b;
+    for (int i = 0; i < C; ++i) _SIP_ROUND;
+    v0 ^= b;
+    v2 ^= 0xff;
+    for (int i = 0; i < D; ++i) _SIP_ROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+#undef _SIP_ROUND
+#undef _SIP_ROTL
+
+#endif // _SIPHASH_H_
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <bit>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace kvs
+{
+    /// @brief Control byte of a slot that was never used since the last table rebuild
+    static constexpr uint8_t CTRL_EMPTY = 0x80;
+
+    /// @brief Control byte of a slot whose entry was deleted (tombstone), probing must continue past it
+    static constexpr uint8_t CTRL_DELETED = 0xFE;
+
+    /// @brief Number of hash bits stored in the control byte of a full slot
+    static constexpr uint8_t CTRL_TAG_BITS = 7;
+
+    /// @brief Extracts 7 bit tag from the top bits of the hash, full slots always have high bit cleared
+    inline uint8_t ctrlTag(uint_fast64_t hash) noexcept {
+        return static_cast<uint8_t>(static_cast<uint64_t>(hash) >> (64 - CTRL_TAG_BITS));
+    }
+
+    inline bool ctrlIsFull(uint8_t ctrl) noexcept {
+        return (ctrl & 0x80) == 0;
+    }
+
+    /// @brief Bit mask of the slots in a group of 8 control bytes, bit i is set for slot i
+    using CtrlMask = uint32_t;
+
+#if defined(__SSE2__)
+    /// @brief Matches all control bytes equal to value with a single SSE2 compare
+    inline CtrlMask ctrlMatch(const uint8_t *ctrl, uint8_t value) noexcept {
+        auto group = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(ctrl));
+        auto matched = _mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(value)));
+        return static_cast<CtrlMask>(_mm_movemask_epi8(matched)) & 0xFF;
+    }
+
+    /// @brief Matches slots which can accept a new entry (empty or deleted)
+    inline CtrlMask ctrlMatchFree(const uint8_t *ctrl) noexcept {
+        auto group = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<CtrlMask>(_mm_movemask_epi8(group)) & 0xFF;
+    }
+#else
+    inline uint64_t ctrlLoad(const uint8_t *ctrl) noexcept {
+        uint64_t group;
+        memcpy(&group, ctrl, sizeof(group));
+        return group;
+    }
+
+    /// @brief Packs 0x80 per byte mask into bit per slot mask
+    inline CtrlMask ctrlPack(uint64_t highBits) noexcept {
+        return static_cast<CtrlMask>(((highBits >> 7) * 0x0102040810204080ull) >> 56);
+    }
+
+    inline CtrlMask ctrlMatch(const uint8_t *ctrl, uint8_t value) noexcept {
+        constexpr uint64_t lsbs = 0x0101010101010101ull;
+        constexpr uint64_t low7 = 0x7F7F7F7F7F7F7F7Full;
+        auto x = ctrlLoad(ctrl) ^ (lsbs * value);
+        auto zeroBytes = ~(((x & low7) + low7) | x | low7);
+        return ctrlPack(zeroBytes);
+    }
+
+    inline CtrlMask ctrlMatchFree(const uint8_t *ctrl) noexcept {
+        return ctrlPack(ctrlLoad(ctrl) & 0x8080808080808080ull);
+    }
+#endif
+
+    inline CtrlMask ctrlMatchEmpty(const uint8_t *ctrl) noexcept {
+        return ctrlMatch(ctrl, CTRL_EMPTY);
+    }
+
+    /// @brief Index of the lowest slot present in mask, mask must not be 0
+    inline int ctrlFirst(CtrlMask mask) noexcept {
+        return std::countr_zero(mask);
+    }
+}
@@ -0,0 +1,85 @@
+#include "epoch.hpp"
+#include <thread>
+
+using namespace kvs;
+
+namespace {
+    /// @brief Reader slot of the calling thread, released when the thread exits
+    struct ThreadSlot {
+        EpochManager::ReaderSlot *slot = nullptr;
+
+        ~ThreadSlot() {
+            if (slot) {
+                slot->claimed.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    thread_local ThreadSlot threadSlot;
+}
+
+EpochManager& EpochManager::shared() {
+    static EpochManager epochs;
+    return epochs;
+}
+
+EpochManager::ReaderSlot* EpochManager::claimSlot() noexcept {
+    for (uint_fast32_t i = 0; i < EPOCH_MAX_READER_THREADS; ++i) {
+        if (slots[i].claimed.load(std::memory_order_relaxed) || slots[i].claimed.exchange(true, std::memory_order_acquire)) {
+            continue;
+        }
+        auto known = numSlots.load();
+        while (known < i + 1 && !numSlots.compare_exchange_weak(known, i + 1));
+        return &slots[i];
+    }
+    return nullptr;
+}
+
+EpochManager::ReadGuard::ReadGuard(EpochManager &epochs) noexcept {
+    if (!threadSlot.slot) {
+        threadSlot.slot = epochs.claimSlot();
+    }
+    slot = threadSlot.slot;
+    if (!slot || slot->depth++) {
+        return;
+    }
+    // Published epoch has to be the current one, otherwise a writer could miss this reader and free memory it is about to reach
+    auto epoch = epochs.globalEpoch.load();
+    while (true) {
+        slot->epoch.store(epoch);
+        auto now = epochs.globalEpoch.load();
+        if (now == epoch) {
+            break;
+        }
+        epoch = now;
+    }
+}
+
+EpochManager::ReadGuard::~ReadGuard() {
+    if (slot && --slot->depth == 0) {
+        slot->epoch.store(0, std::memory_order_release);
+    }
+}
+
+uint_fast64_t EpochManager::advance() noexcept {
+    auto safeEpoch = globalEpoch.fetch_add(1) + 1;
+    auto count = numSlots.load();
+    for (uint_fast32_t i = 0; i < count; ++i) {
+        auto epoch = slots[i].epoch.load();
+        if (epoch && epoch < safeEpoch) {
+            safeEpoch = epoch;
+        }
+    }
+    return safeEpoch;
+}
+
+void EpochManager::synchronize() noexcept {
+    auto target = globalEpoch.fetch_add(1) + 1;
+    auto count = numSlots.load();
+    for (uint_fast32_t i = 0; i < count; ++i) {
+        // Readers never wait for writers, so they leave their epoch shortly
+        for (auto epoch = slots[i].epoch.load(); epoch && epoch < target; epoch = slots[i].epoch.load()) {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <atomic>
+#include "../non_copyable.hpp"
+
+/// @brief Max number of threads reading stores concurrently at the same time, readers beyond it fall back to the writer's path
+#define EPOCH_MAX_READER_THREADS 256
+
+namespace kvs
+{
+    /// @brief Epoch based reclamation shared by all stores of the process. Lock-free readers publish the epoch they started in,
+    /// writers tag memory they unlink with the current epoch and free it once no reader can be in that epoch anymore
+    class EpochManager : NonCopyableOrMovable {
+        public:
+            struct alignas(64) ReaderSlot {
+                /// @brief Epoch the reader started in, 0 - not reading
+                std::atomic<uint_fast64_t> epoch { 0 };
+                std::atomic<bool> claimed { false };
+                /// @brief Nested read sections of the owning thread
+                uint_fast32_t depth = 0;
+            };
+
+            /// @brief Keeps the calling thread in the epoch it entered while in scope
+            class ReadGuard : NonCopyableOrMovable {
+                private:
+                    ReaderSlot *slot;
+
+                public:
+                    explicit ReadGuard(EpochManager &epochs) noexcept;
+                    ~ReadGuard();
+
+                    /// @brief false if all reader slots are taken, the caller must not read then
+                    explicit operator bool() const noexcept {
+                        return slot != nullptr;
+                    }
+            };
+
+        private:
+            std::atomic<uint_fast64_t> globalEpoch { 1 };
+            std::array<ReaderSlot, EPOCH_MAX_READER_THREADS> slots;
+            /// @brief Slots at and above it were never claimed, so writers do not scan them
+            std::atomic<uint_fast32_t> numSlots { 0 };
+
+            EpochManager() = default;
+            ReaderSlot* claimSlot() noexcept;
+
+        public:
+            /// @brief Epoch to tag memory with right after it is unlinked
+            uint_fast64_t current() const noexcept {
+                return globalEpoch.load();
+            }
+
+            /// @brief Starts a new epoch
+            /// @return Memory tagged with an epoch lower than the returned one is not referenced by any reader
+            uint_fast64_t advance() noexcept;
+
+            /// @brief Waits until readers which may have seen memory unlinked before the call are done, so it can be freed right away
+            void synchronize() noexcept;
+
+            static EpochManager& shared();
+    };
+}
@@ -0,0 +1,86 @@
+#include "helper_pool.hpp"
+#include <algorithm>
+
+using namespace kvs;
+
+HelperPool::HelperPool(unsigned numHelpers) {
+    helpers.reserve(numHelpers);
+    for (unsigned i = 0; i < numHelpers; ++i) {
+        helpers.emplace_back([this] { runHelper(); });
+    }
+}
+
+HelperPool::~HelperPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobQueued.notify_all();
+    helpers.clear();
+}
+
+HelperPool& HelperPool::shared() {
+    static HelperPool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    return pool;
+}
+
+void HelperPool::runChunks(Job &job) {
+    auto numChunks = (job.count + job.chunkSize - 1) / job.chunkSize;
+    for (auto chunk = job.nextChunk.fetch_add(1, std::memory_order_relaxed); chunk < numChunks; chunk = job.nextChunk.fetch_add(1, std::memory_order_relaxed)) {
+        auto begin = chunk * job.chunkSize;
+        (*job.body)(begin, std::min(job.count, begin + job.chunkSize));
+    }
+}
+
+void HelperPool::runHelper() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        jobQueued.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping) {
+            return;
+        }
+        auto *job = jobs.front();
+        ++job->numActive;
+        if (--job->helpersWanted == 0) {
+            jobs.pop_front();
+        }
+        lock.unlock();
+        runChunks(*job);
+        lock.lock();
+        if (--job->numActive == 0) {
+            helperDone.notify_all();
+        }
+    }
+}
+
+void HelperPool::parallelFor(size_t count, size_t chunkSize, unsigned maxHelpers, const std::function<void(size_t, size_t)> &body) {
+    if (count == 0) {
+        return;
+    }
+    chunkSize = std::max<size_t>(chunkSize, 1);
+    auto numChunks = (count + chunkSize - 1) / chunkSize;
+    Job job {
+        .count = count,
+        .chunkSize = chunkSize,
+        .body = &body,
+        .helpersWanted = static_cast<unsigned>(std::min<size_t>({ maxHelpers, helpers.size(), numChunks - 1 })),
+    };
+    bool queued = job.helpersWanted != 0;
+    if (queued) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(&job);
+        }
+        jobQueued.notify_all();
+    }
+    runChunks(job);
+    if (!queued) {
+        return;
+    }
+    // Helpers which did not pick the job up yet are not needed anymore, the job lives on this stack frame so the ones working on it are waited for
+    std::unique_lock<std::mutex> lock(mutex);
+    if (auto it = std::find(jobs.begin(), jobs.end(), &job); it != jobs.end()) {
+        jobs.erase(it);
+    }
+    helperDone.wait(lock, [&job] { return job.numActive == 0; });
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../non_copyable.hpp"
+
+namespace kvs
+{
+    /// @brief Fixed set of helper threads which split index ranges between them and the calling thread.
+    /// Several callers may run jobs at once, helpers go through the queued jobs in order
+    class HelperPool : NonCopyableOrMovable {
+        private:
+            struct Job {
+                size_t count = 0;
+                size_t chunkSize = 0;
+                const std::function<void(size_t, size_t)> *body = nullptr;
+                /// @brief Next chunk to be taken by any thread working on the job
+                std::atomic<size_t> nextChunk { 0 };
+                /// @brief Helpers which may still join the job, it leaves the queue when it drops to zero
+                unsigned helpersWanted = 0;
+                /// @brief Helpers working on the job, guarded by mutex
+                unsigned numActive = 0;
+            };
+
+            std::mutex mutex;
+            std::condition_variable jobQueued;
+            std::condition_variable helperDone;
+            std::deque<Job*> jobs;
+            std::vector<std::jthread> helpers;
+            bool stopping = false;
+
+            void runHelper();
+            static void runChunks(Job &job);
+
+        public:
+            explicit HelperPool(unsigned numHelpers);
+            ~HelperPool();
+
+            /// @brief Calls body(begin, end) for consecutive ranges of up to chunkSize indexes covering [0, count), on the calling thread and up to maxHelpers helpers.
+            /// Returns once all ranges are done. Ranges run concurrently, so body must be thread safe and must not throw
+            void parallelFor(size_t count, size_t chunkSize, unsigned maxHelpers, const std::function<void(size_t, size_t)> &body);
+
+            unsigned getNumHelpers() const noexcept {
+                return static_cast<unsigned>(helpers.size());
+            }
+
+            /// @brief Pool shared by all stores of the process, with a helper per hardware thread except the calling one
+            static HelperPool& shared();
+    };
+}
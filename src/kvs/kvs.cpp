@@ -3,20 +3,42 @@
 using namespace kvs;
 
 KeyValueStore::KeyValueStore(KeyValueStoreSettings settings)
-    : tableSize(settings.initialSize),
+    : tableSize(settings.usePrimeNumbers ? settings.initialSize : std::bit_ceil(settings.initialSize)),
       numEntries(0),
       numCollisions(0),
       numResizes(0),
+      entryPool(settings.initialSize),
       isResizing(false),
-      compressionEnabled(settings.compressionEnabled),
+      incrementalResize(settings.incrementalResize),
+      migrationBatchSize(settings.migrationBatchSize),
+      rehashThreads(std::max<uint_fast32_t>(settings.rehashThreads, 1)),
+      shrinkEnabled(settings.shrinkEnabled),
+      expirations(monotonicMsec()),
+      maxMemory(settings.maxMemory),
+      evictionPolicy(settings.evictionPolicy),
+      evictionSamples(std::max<uint_fast32_t>(settings.evictionSamples, 1)),
+      clockMs(monotonicMsec()),
+      randomState((reinterpret_cast<uintptr_t>(this) ^ (clockMs * 0x9E3779B97F4A7C15ull)) | 1),
       usePrimeNumbers(settings.usePrimeNumbers),
-      entryPool(settings.initialSize) {
+      compressionEnabled(settings.compressionEnabled),
+      compressionLevel(settings.compressionLevel),
+      codec(settings.codec),
+      dictionaries(settings.dictionarySize),
+      minCompressionSavings(std::min<uint_fast32_t>(settings.minCompressionSavings, 100)),
+      compressColdAfterMs(settings.compressColdAfterMs),
+      valueCache(settings.valueCacheSize),
+      respFraming(settings.respFraming),
+      concurrentReads(settings.concurrentReads) {
 #ifndef NDEBUG
     std::cout << "Table initialization started! initialSize = " << tableSize << " usePrimeNumbers = " << usePrimeNumbers 
-              << " compressionEnabled = " << compressionEnabled << std::endl;
+              << " compressionEnabled = " << compressionEnabled << " codec = " << ValueCodec::Name(codec) << std::endl;
 #endif
+    if (concurrentReads) {
+        entryPool.reserveSegments(POOL_MAX_SEGMENTS);
+    }
     table = new Bucket[tableSize];
     initializeTable(table, tableSize);
+    rebuildStash();
 #ifndef NDEBUG
     std::cout << "Table initialization finished!\n";
 #endif
@@ -26,15 +48,28 @@ KeyValueStore::~KeyValueStore() {
 #ifndef NDEBUG
     std::cout << "Destroying KeyValueStore... Entries: " << numEntries << ", Table Size: " << tableSize << std::endl;
 #endif
+    if (oldTable) {
+        cleanTable(oldTable, oldTableSize);
+    }
     cleanTable(table, tableSize);
+    for (auto &bucket : stash) {
+        for (int j = 0; j < BUCKET_SIZE; ++j) {
+            if (ctrlIsFull(bucket.ctrl[j])) {
+                releaseEntry(bucket.entries[j]);
+            }
+        }
+    }
+    for (auto &record : retiredRecords) {
+        allocator.deallocate(record.data, record.size);
+    }
 }
 
 
 inline void KeyValueStore::initializeTable(Bucket *table, uint_fast64_t size) {
     for (uint_fast64_t i = 0; i < size; ++i) {
-        for (int j = 0; j < BUCKET_SIZE; ++j) {
-            table[i].entries[j] = 0;
-        }
+        memset(table[i].ctrl, CTRL_EMPTY, BUCKET_SIZE);
+        memset(table[i].entries, 0, sizeof(table[i].entries));
+        table[i].version = 0;
     }
 }
 
@@ -44,9 +79,8 @@ inline void KeyValueStore::cleanTable(Bucket *tableToDelete, uint_fast64_t size)
 #endif
         for (uint_fast64_t i = 0; i < size; ++i) {
             for (int j = 0; j < BUCKET_SIZE; ++j) {
-                auto entryIdx = tableToDelete[i].entries[j];
-                if (!entryIdx) continue;
-                entryPool.deallocate(entryIdx);
+                if (!ctrlIsFull(tableToDelete[i].ctrl[j])) continue;
+                releaseEntry(tableToDelete[i].entries[j]);
             }
         }
         delete[] tableToDelete;
@@ -57,217 +91,1199 @@ inline void KeyValueStore::cleanTable(Bucket *tableToDelete, uint_fast64_t size)
 
 
 inline uint_fast64_t KeyValueStore::calcIndex(uint_fast64_t hash, int attempt, uint_fast64_t tableSize) const {
+    if (!usePrimeNumbers) {
+        // Power of two sizes take the low hash bits, they do not overlap with shard (shardIndex) and tag (ctrlTag) bits
+        return (hash + attempt * attempt) & (tableSize - 1);
+    }
     return (hash + attempt * attempt) % tableSize;
 }
 
 void KeyValueStore::resize() {
+    if (oldTable) {
+        finishMigration();
+    }
+    uint_fast64_t newTableSize;
+    if (!largerSizes.empty()) {
+        newTableSize = largerSizes.back();
+        largerSizes.pop_back();
+    } else {
+        newTableSize = usePrimeNumbers ? primegen.PopNext() : tableSize * 2;
+    }
+    smallerSizes.push_back(tableSize);
+    rebuildTable(newTableSize);
+}
+
+/// @brief Moves all keys into a new table, which also drops tombstones of the current one. Incremental mode only starts the migration
+void KeyValueStore::rebuildTable(uint_fast64_t newTableSize) {
+    if (oldTable) {
+        finishMigration();
+    }
+    VersionWrite layoutChange(*this, layoutVersion);
     isResizing = true;
 #ifndef NDEBUG
     auto start = std::chrono::high_resolution_clock::now();
-    std::cout << "Resizing started! numEntries = " << numEntries << " tableSize = " << tableSize << std::endl;
+    std::cout << "Resizing started! numEntries = " << numEntries << " tableSize = " << tableSize << " newTableSize = " << newTableSize << std::endl;
 #endif
-    uint_fast64_t newTableSize = usePrimeNumbers ? primegen.PopNext() : tableSize * 2;
-
-    entryPool.expandPool(newTableSize);
+    // Blocking resize of a big table is spread over helper threads, incremental resize keeps every step short on its own
+    bool parallel = !incrementalResize && rehashThreads > 1 && tableSize >= PARALLEL_REHASH_MIN_BUCKETS;
     auto *newTable = new Bucket[newTableSize];
-    initializeTable(newTable, newTableSize);
+    if (parallel) {
+        HelperPool::shared().parallelFor(newTableSize, PARALLEL_REHASH_CHUNK_BUCKETS, rehashThreads - 1, [this, newTable](size_t begin, size_t end) {
+            initializeTable(newTable + begin, end - begin);
+        });
+    } else {
+        initializeTable(newTable, newTableSize);
+    }
 
-    #pragma omp parallel for schedule(dynamic)
-    for (uint_fast64_t i = 0; i < tableSize; ++i) {
-        for (int j = 0; j < BUCKET_SIZE; ++j) {
-            auto entryIdx = table[i].entries[j];
-            if (!entryIdx) {
-                continue;
-            }
-            migrateEntry(newTable, newTableSize, entryIdx);
-        }
+    if (incrementalResize) {
+        startMigration(newTable, newTableSize);
+        return;
     }
 
-    delete[] table;
+    auto *previousTable = table;
+    auto previousTableSize = tableSize;
     table = newTable;
     tableSize = newTableSize;
+    numTombstones = 0;
+    rebuildStash();
+
+    if (parallel) {
+        migrateParallel(previousTable, previousTableSize);
+    } else {
+        for (uint_fast64_t i = 0; i < previousTableSize; ++i) {
+            for (int j = 0; j < BUCKET_SIZE; ++j) {
+                if (!ctrlIsFull(previousTable[i].ctrl[j])) {
+                    continue;
+                }
+                migrateEntry(table, tableSize, previousTable[i].entries[j]);
+            }
+        }
+    }
+
+    retireTable(previousTable);
     isResizing = false;
     ++numResizes;
 #ifndef NDEBUG
     auto stop = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
     std::cout << "Resizing finished in " << duration.count() << " ms ! numEntries = " << numEntries 
-              << " tableSize = " << tableSize << std::endl;
+              << " tableSize = " << tableSize << " threads = " << (parallel ? rehashThreads : 1) << std::endl;
 #endif
 }
 
-void KeyValueStore::migrateEntry(Bucket *newTable, uint_fast64_t newTableSize, uint_fast64_t entryIdx) {
-    auto entry = entryPool.get(entryIdx);
-    if (!entry.key) {
+void KeyValueStore::shrink() {
+    if (oldTable) {
+        finishMigration();
+    }
+    // Go back through the sizes the table has grown from while the load stays under the target
+    auto minSize = numEntries * 100 / (SHRINK_TARGET_LOAD_PERCENTAGE * BUCKET_SIZE) + 1;
+    auto newTableSize = tableSize;
+    while (!smallerSizes.empty() && smallerSizes.back() >= minSize) {
+        largerSizes.push_back(newTableSize);
+        newTableSize = smallerSizes.back();
+        smallerSizes.pop_back();
+    }
+    if (newTableSize == tableSize) {
         return;
     }
+    VersionWrite layoutChange(*this, layoutVersion);
+    isResizing = true;
+#ifndef NDEBUG
+    std::cout << "Shrinking started! numEntries = " << numEntries << " tableSize = " << tableSize << " newTableSize = " << newTableSize << std::endl;
+#endif
+    ++numShrinks;
+    // Entries are moved below the new pool capacity while they are migrated, so the tail of the pool can be released at the end
+    poolShrinkLimit = newTableSize * BUCKET_SIZE * SHRINK_TARGET_LOAD_PERCENTAGE / 100 + 1;
+    entryPool.restrictTo(poolShrinkLimit);
 
-    uint_fast64_t attempt = 0, idx;
-    uint_fast64_t primaryHash = hashFunc(entry.key);
-    bool migrated = false;
+    auto *newTable = new Bucket[newTableSize];
+    initializeTable(newTable, newTableSize);
+    startMigration(newTable, newTableSize);
+    if (!incrementalResize) {
+        finishMigration();
+    }
+}
 
+void KeyValueStore::shrinkIfSparse() {
+    if (!shrinkEnabled || oldTable || smallerSizes.empty()) {
+        return;
+    }
+    if (numEntries * 100 < tableSize * BUCKET_SIZE * SHRINK_THRESHOLD_PERCENTAGE) {
+        shrink();
+    }
+}
+
+void KeyValueStore::startMigration(Bucket *newTable, uint_fast64_t newTableSize) {
+    oldTable = table;
+    oldTableSize = tableSize;
+    migrationCursor = 0;
+    table = newTable;
+    tableSize = newTableSize;
+    numTombstones = 0;
+    // Stashed keys get into the new table right away, the ones which do not fit stay stashed for it
+    rebuildStash();
+#ifndef NDEBUG
+    std::cout << "Incremental resizing started! oldTableSize = " << oldTableSize << " tableSize = " << tableSize << std::endl;
+#endif
+}
+
+uint_fast64_t KeyValueStore::relocateEntry(uint_fast64_t entryIdx) {
+    auto newEntry = entryPool.allocate();
+    auto &entry = entryPool.get(entryIdx);
+    // Record bytes stay where they are, only the header moves
+    memcpy(&newEntry.entry, &entry, sizeof(Entry));
+    if (entry.codec != CodecId::None) {
+        valueCache.erase(static_cast<uint32_t>(entryIdx));
+    }
+    entryPool.deallocate(entryIdx);
+    if (newEntry.entry.expiresAt) {
+        // Scheduled record points to the old index, it is recognized as stale when it fires
+        scheduleExpiration(newEntry.i);
+    }
+    return newEntry.i;
+}
+
+void KeyValueStore::migrateBuckets(uint_fast64_t count) {
+    // Keys move between tables, concurrent readers must not miss them in between
+    VersionWrite layoutChange(*this, layoutVersion);
+    auto end = std::min(oldTableSize, migrationCursor + count);
+    for (; migrationCursor < end; ++migrationCursor) {
+        auto &bucket = oldTable[migrationCursor];
+        for (int j = 0; j < BUCKET_SIZE; ++j) {
+            if (!ctrlIsFull(bucket.ctrl[j])) {
+                continue;
+            }
+            uint_fast64_t entryIdx = bucket.entries[j];
+            if (poolShrinkLimit && entryIdx >= poolShrinkLimit) {
+                entryIdx = relocateEntry(entryIdx);
+            }
+            migrateEntry(table, tableSize, entryIdx);
+            // Migrated slots become tombstones, so probe chains of not yet migrated keys stay intact
+            bucket.ctrl[j] = CTRL_DELETED;
+            bucket.entries[j] = 0;
+        }
+    }
+
+    if (migrationCursor >= oldTableSize) {
+        retireTable(oldTable);
+        oldTable = nullptr;
+        oldTableSize = 0;
+        migrationCursor = 0;
+        isResizing = false;
+        ++numResizes;
+        if (poolShrinkLimit) {
+            entryPool.shrinkPool(poolShrinkLimit);
+            poolShrinkLimit = 0;
+        }
+#ifndef NDEBUG
+        std::cout << "Incremental resizing finished! numEntries = " << numEntries << " tableSize = " << tableSize << std::endl;
+#endif
+    }
+}
+
+/// @brief Migrates all keys of the previous table into the current (empty) one, old buckets are split between rehash threads which claim new slots with CAS
+void KeyValueStore::migrateParallel(const Bucket *previousTable, uint_fast64_t previousTableSize) {
+    std::mutex overflowMutex;
+    std::vector<uint32_t> overflow;
+    HelperPool::shared().parallelFor(previousTableSize, PARALLEL_REHASH_CHUNK_BUCKETS, rehashThreads - 1, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            for (int j = 0; j < BUCKET_SIZE; ++j) {
+                if (ctrlIsFull(previousTable[i].ctrl[j]) && !claimSlot(table, tableSize, previousTable[i].entries[j])) {
+                    std::lock_guard<std::mutex> lock(overflowMutex);
+                    overflow.push_back(previousTable[i].entries[j]);
+                }
+            }
+        }
+    });
+    // The stash is not thread safe, keys with a full probe sequence are rare and get there once all threads are done
+    for (auto entryIdx : overflow) {
+        migrateEntry(table, tableSize, entryIdx);
+    }
+}
+
+void KeyValueStore::finishMigration() {
+    migrateBuckets(oldTableSize);
+}
+
+bool KeyValueStore::maintenance() {
+    // Training is split into steps too, a whole training would stall requests for tens of milliseconds
+    bool trainingLeft = dictionaries.trainStep();
+    if (oldTable) {
+        migrateBuckets(migrationBatchSize);
+    } else {
+        shrinkIfSparse();
+    }
+    if (compressColdAfterMs && compressionEnabled && codec != CodecId::None) {
+        compressColdEntries();
+    }
+    reclaimRecords();
+    return oldTable != nullptr || trainingLeft;
+}
+
+void KeyValueStore::migrateEntry(Bucket *newTable, uint_fast64_t newTableSize, uint_fast64_t entryIdx) {
+    if (placeEntry(newTable, newTableSize, entryIdx) || stashEntry(entryIdx)) {
+        return;
+    }
+    auto &entry = entryPool.get(entryIdx);
+    std::cerr << "Could not migrate entry, key = " << std::string_view(entry.key(), entry.kSize) << ", entryIdx = " << entryIdx << std::endl;
+}
+
+/// @brief Puts entry into the first free slot of its probe sequence
+/// @return false if all probed buckets are full
+bool KeyValueStore::placeEntry(Bucket *tbl, uint_fast64_t size, uint_fast64_t entryIdx) {
+    auto hash = entryPool.get(entryIdx).hash;
+    uint_fast64_t attempt = 0;
     do {
-        idx = calcIndex(primaryHash, attempt++, newTableSize);
-        for (int k = 0; k < BUCKET_SIZE; ++k) {
-            if (!newTable[idx].entries[k]) {
-                newTable[idx].entries[k] = entryIdx;
-                migrated = true;
-                break;
+        auto &bucket = tbl[calcIndex(hash, attempt++, size)];
+        auto freeSlots = ctrlMatchFree(bucket.ctrl);
+        if (freeSlots) {
+            auto slot = ctrlFirst(freeSlots);
+            if (bucket.ctrl[slot] == CTRL_DELETED && tbl == table) {
+                --numTombstones;
+            }
+            bucket.ctrl[slot] = ctrlTag(hash);
+            bucket.entries[slot] = static_cast<uint32_t>(entryIdx);
+            return true;
+        }
+    } while (attempt < MAX_READ_WRITE_ATTEMPTS);
+    return false;
+}
+
+/// @brief Thread safe placeEntry for a table without tombstones which is filled by several threads at once.
+/// A slot belongs to the thread which swapped its control byte from empty, only that thread writes the entry index
+bool KeyValueStore::claimSlot(Bucket *tbl, uint_fast64_t size, uint_fast64_t entryIdx) {
+    auto hash = entryPool.get(entryIdx).hash;
+    auto tag = ctrlTag(hash);
+    for (int attempt = 0; attempt < MAX_READ_WRITE_ATTEMPTS; ++attempt) {
+        auto &bucket = tbl[calcIndex(hash, attempt, size)];
+        for (int j = 0; j < BUCKET_SIZE; ++j) {
+            std::atomic_ref<uint8_t> ctrl(bucket.ctrl[j]);
+            uint8_t expected = CTRL_EMPTY;
+            // Threads join before the table is read again, so the entry write needs no ordering of its own
+            if (ctrl.load(std::memory_order_relaxed) == CTRL_EMPTY && ctrl.compare_exchange_strong(expected, tag, std::memory_order_relaxed)) {
+                bucket.entries[j] = static_cast<uint32_t>(entryIdx);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/// @return false if the stash is full
+bool KeyValueStore::stashEntry(uint_fast64_t entryIdx) {
+    for (auto &bucket : stash) {
+        auto freeSlots = ctrlMatchFree(bucket.ctrl);
+        if (freeSlots) {
+            VersionWrite write(*this, bucket.version);
+            auto slot = ctrlFirst(freeSlots);
+            bucket.ctrl[slot] = ctrlTag(entryPool.get(entryIdx).hash);
+            bucket.entries[slot] = static_cast<uint32_t>(entryIdx);
+            ++numStashed;
+            return true;
+        }
+    }
+    return false;
+}
+
+Bucket* KeyValueStore::findStashed(const char *key, size_t kSize, uint_fast64_t hash, int &slot) {
+    auto tag = ctrlTag(hash);
+    for (auto &bucket : stash) {
+        for (auto matched = ctrlMatch(bucket.ctrl, tag); matched; matched &= matched - 1) {
+            auto i = ctrlFirst(matched);
+            if (entryPool.get(bucket.entries[i]).matches(key, kSize, hash)) {
+                slot = i;
+                return &bucket;
             }
         }
-    } while (!migrated && attempt < MAX_READ_WRITE_ATTEMPTS);
+    }
+    return nullptr;
+}
+
+/// @brief Sizes the stash for the current table and moves stashed keys into the table wherever their probe sequence has room now
+void KeyValueStore::rebuildStash() {
+    std::vector<uint32_t> stashed;
+    stashed.reserve(numStashed);
+    for (auto &bucket : stash) {
+        for (int j = 0; j < BUCKET_SIZE; ++j) {
+            if (ctrlIsFull(bucket.ctrl[j])) {
+                stashed.push_back(bucket.entries[j]);
+            }
+        }
+    }
+    auto numBuckets = std::max<uint_fast64_t>({ tableSize / OVERFLOW_STASH_TABLE_RATIO, OVERFLOW_STASH_MIN_BUCKETS, (stashed.size() + BUCKET_SIZE - 1) / BUCKET_SIZE });
+    // Concurrent readers may still scan the previous stash
+    std::vector<Bucket> previousStash;
+    previousStash.swap(stash);
+    stash.assign(numBuckets, Bucket{});
+    initializeTable(stash.data(), stash.size());
+    numStashed = 0;
+    for (uint_fast64_t entryIdx : stashed) {
+        if (poolShrinkLimit && entryIdx >= poolShrinkLimit) {
+            entryIdx = relocateEntry(entryIdx);
+        }
+        if (!placeEntry(table, tableSize, entryIdx)) {
+            stashEntry(entryIdx);
+        }
+    }
+    if (concurrentReads && !previousStash.empty()) {
+        EpochManager::shared().synchronize();
+    }
+}
 
-    if (!migrated) {
-        std::cerr << "Could not migrate entry, key = " << entry.key << ", entryIdx = " << entryIdx << std::endl;
+/// @brief Allocates record of an entry and writes its zero terminator, framed records also get their RESP bulk string header and trailing CRLF
+inline char* KeyValueStore::allocateRecord(Entry &entry, size_t kSize, size_t vSize, bool framed) {
+    entry.kSize = static_cast<uint32_t>(kSize);
+    entry.vSize = static_cast<uint32_t>(vSize);
+    char lengthDigits[10];
+    size_t numDigits = 0;
+    if (framed) {
+        numDigits = std::to_chars(lengthDigits, lengthDigits + sizeof(lengthDigits), entry.vSize).ptr - lengthDigits;
+    }
+    entry.respHeaderSize = framed ? static_cast<uint8_t>(numDigits + 3) : 0;
+    char *bytes;
+    if (entry.recordSize() <= ENTRY_INLINE_CAPACITY) {
+        entry.isInline = true;
+        entry.data = nullptr;
+        bytes = entry.inlineData;
+    } else {
+        entry.isInline = false;
+        entry.data = allocator.allocate(entry.recordSize());
+        bytes = entry.data;
+    }
+    if (framed) {
+        auto header = bytes + kSize;
+        header[0] = '$';
+        memcpy(header + 1, lengthDigits, numDigits);
+        header[numDigits + 1] = '\r';
+        header[numDigits + 2] = '\n';
+        header[entry.respHeaderSize + vSize] = '\r';
+        header[entry.respHeaderSize + vSize + 1] = '\n';
+    }
+    bytes[entry.recordSize() - 1] = '\0';
+    return bytes;
+}
+
+/// @brief Record size of a new uncompressed value, including RESP framing when the store keeps it
+inline size_t KeyValueStore::recordSizeOf(size_t kSize, size_t vSize) const noexcept {
+    size_t framingSize = 0;
+    if (respFraming) {
+        // "$", length digits and two CRLFs
+        framingSize = 6;
+        for (auto length = vSize; length >= 10; length /= 10) {
+            ++framingSize;
+        }
     }
+    return kSize + vSize + 1 + framingSize;
 }
 
 inline void KeyValueStore::copyEntry(Entry &dest, const Entry &src) {
-    auto kSize = strlen(src.key) + 1;
-    auto vSize = strlen(src.value) + 1;
-    dest.key = new char[kSize];
-    dest.value = new char[vSize];
-    memcpy(dest.key, src.key, kSize);
-    memcpy(dest.value, src.value, vSize);
-    dest.vSize = src.vSize;
-    dest.compressed = src.compressed;
+    auto bytes = allocateRecord(dest, src.kSize, src.vSize, src.respHeaderSize != 0);
+    memcpy(bytes, src.bytes(), src.recordSize() - 1);
+    dest.codec = src.codec;
+    dest.incompressible = src.incompressible;
+    if (dest.codec == CodecId::DeflateDict) {
+        dictionaries.acquire(DictionaryCompressor::DictionaryId(dest.value()));
+    }
+    dest.hash = src.hash;
+    dest.expiresAt = src.expiresAt;
+}
+
+inline void KeyValueStore::releaseEntry(uint_fast64_t entryIdx) {
+    auto &entry = entryPool.get(entryIdx);
+    usedMemory -= entry.memoryUsage();
+    if (entry.codec != CodecId::None) {
+        valueCache.erase(static_cast<uint32_t>(entryIdx));
+    }
+    if (entry.codec == CodecId::DeflateDict) {
+        dictionaries.release(DictionaryCompressor::DictionaryId(entry.value()));
+    }
+    if (!entry.isInline) {
+        freeRecord(entry.data, entry.recordSize());
+    }
+    entryPool.deallocate(entryIdx);
+}
+
+inline void KeyValueStore::freeRecord(char *data, size_t size) {
+    if (!numPins && !concurrentReads) {
+        allocator.deallocate(data, size);
+        return;
+    }
+    retiredRecords.push_back(RetiredRecord{ data, size, concurrentReads ? EpochManager::shared().current() : 0 });
+    if (retiredRecords.size() >= RETIRED_RECORDS_RECLAIM_BATCH) {
+        reclaimRecords();
+    }
+}
+
+void KeyValueStore::unpin() {
+    if (--numPins == 0) {
+        reclaimRecords();
+    }
+}
+
+/// @brief Frees retired records unless the store is pinned, with concurrent reads only the ones no reader can refer to anymore
+void KeyValueStore::reclaimRecords() {
+    if (numPins || retiredRecords.empty()) {
+        return;
+    }
+    auto safeEpoch = concurrentReads ? EpochManager::shared().advance() : UINT_FAST64_MAX;
+    // Records are retired in epoch order
+    auto end = std::find_if(retiredRecords.begin(), retiredRecords.end(), [safeEpoch](const RetiredRecord &record) {
+        return record.epoch >= safeEpoch;
+    });
+    for (auto it = retiredRecords.begin(); it != end; ++it) {
+        allocator.deallocate(it->data, it->size);
+    }
+    retiredRecords.erase(retiredRecords.begin(), end);
+}
+
+/// @brief Deletes a table which is not referred to by the store anymore, after concurrent readers which could still probe it are done
+void KeyValueStore::retireTable(Bucket *tableToDelete) {
+    if (concurrentReads) {
+        EpochManager::shared().synchronize();
+    }
+    delete[] tableToDelete;
 }
 
 bool KeyValueStore::set(const char *key, const char *value) {
-    auto primaryHash = hashFunc(key);
-    return set(key, value, primaryHash);
+    return set(key, strlen(key), value, strlen(value));
 }
 
-bool KeyValueStore::set(const char *key, const char *value, uint_fast64_t hash) {
-    if (numEntries >= ((tableSize * RESIZE_THRESHOLD_PERCENTAGE) / 100) && !isResizing) {
-        resize();
+bool KeyValueStore::set(const char *key, size_t kSize, const char *value, size_t vSize) {
+    return set(key, kSize, value, vSize, hashFunc(key, kSize));
+}
+
+bool KeyValueStore::findSlot(const Bucket *tbl, uint_fast64_t size, const char *key, size_t kSize, uint_fast64_t hash, uint_fast64_t &bucketIdx, int &slot, bool *chainFull) const {
+    auto tag = ctrlTag(hash);
+    uint_fast64_t attempt = 0;
+    do {
+        bucketIdx = calcIndex(hash, attempt++, size);
+        auto &bucket = tbl[bucketIdx];
+        for (auto matched = ctrlMatch(bucket.ctrl, tag); matched; matched &= matched - 1) {
+            auto i = ctrlFirst(matched);
+            auto &entry = entryPool.get(bucket.entries[i]);
+            if (entry.matches(key, kSize, hash)) {
+                slot = i;
+                return true;
+            }
+        }
+        // Key is always stored in the first group with a free slot, so an empty slot ends the probe sequence
+        if (ctrlMatchEmpty(bucket.ctrl)) {
+            return false;
+        }
+    } while (attempt < MAX_READ_WRITE_ATTEMPTS);
+    if (chainFull) {
+        *chainFull = true;
+    }
+    return false;
+}
+
+Bucket* KeyValueStore::locate(const char *key, size_t kSize, uint_fast64_t hash, int &slot) {
+    uint_fast64_t idx;
+    bool chainFull = false;
+    if (findSlot(table, tableSize, key, kSize, hash, idx, slot, &chainFull)) {
+        return &table[idx];
+    }
+    if (oldTable && findSlot(oldTable, oldTableSize, key, kSize, hash, idx, slot)) {
+        return &oldTable[idx];
+    }
+    if (chainFull && numStashed) {
+        return findStashed(key, kSize, hash, slot);
+    }
+    return nullptr;
+}
+
+Bucket* KeyValueStore::locateLive(const char *key, size_t kSize, uint_fast64_t hash, int &slot) {
+    auto bucket = locate(key, kSize, hash, slot);
+    if (!bucket) {
+        return nullptr;
+    }
+    auto &entry = entryPool.get(bucket->entries[slot]);
+    // Lazy expiration, clock is only read for keys with TTL
+    if (entry.expiresAt && entry.isExpired(monotonicMsec())) {
+        eraseSlot(*bucket, slot);
+        ++numExpired;
+        return nullptr;
+    }
+    return bucket;
+}
+
+void KeyValueStore::eraseSlot(Bucket &bucket, int slot) {
+    VersionWrite write(*this, bucket.version);
+    releaseEntry(bucket.entries[slot]);
+    --numEntries;
+    bucket.entries[slot] = 0;
+    if (isStashed(bucket)) {
+        bucket.ctrl[slot] = CTRL_EMPTY;
+        --numStashed;
+        return;
+    }
+    // Slot may become empty again only if the group still has an empty slot, otherwise probe chains passing through it would break
+    if (ctrlMatchEmpty(bucket.ctrl)) {
+        bucket.ctrl[slot] = CTRL_EMPTY;
+        return;
+    }
+    bucket.ctrl[slot] = CTRL_DELETED;
+    if (&bucket >= table && &bucket < table + tableSize) {
+        ++numTombstones;
+    }
+}
+
+bool KeyValueStore::set(const char *key, size_t kSize, const char *value, size_t vSize, uint_fast64_t hash, uint_fast64_t ttlMs) {
+    if (oldTable) {
+        migrateBuckets(migrationBatchSize);
+    }
+    outOfMemory = false;
+    if (maxMemory && !reserveMemory(kSize, vSize)) {
+        outOfMemory = true;
+        return false;
+    }
+    auto growthLimit = tableSize * BUCKET_SIZE * RESIZE_THRESHOLD_PERCENTAGE / 100;
+    if (numEntries + numTombstones >= growthLimit && !oldTable) {
+        // Table filled up mostly with tombstones, rebuilding it at the same size is enough
+        if (numEntries * 2 < growthLimit) {
+            rebuildTable(tableSize);
+        } else {
+            resize();
+        }
     }
 
-    uint_fast64_t attempt = 0, idx;
-    auto kSize = strlen(key) + 1;
-    auto vSize = strlen(value) + 1;
+    auto tag = ctrlTag(hash);
+    uint_fast64_t expiresAt = ttlMs ? monotonicMsec() + ttlMs : 0;
+
+    uint_fast64_t attempt = 0, idx, freeIdx = 0;
+    int freeSlot = -1;
+    bool chainFull = true;
 
     do {
         idx = calcIndex(hash, attempt++, tableSize);
-        for (int i = 0; i < BUCKET_SIZE; ++i) {
-            auto entryIdx = table[idx].entries[i];
-            if (entryIdx) {
-                auto entry = entryPool.get(entryIdx);
-                if (entry.key) {
-                    if (strcmp(entry.key, key) == 0) {
-                        entryPool.deallocate(entryIdx);
-                    } else {
-                        continue;
-                    }
-                }
+        auto &bucket = table[idx];
+        for (auto matched = ctrlMatch(bucket.ctrl, tag); matched; matched &= matched - 1) {
+            auto i = ctrlFirst(matched);
+            auto &entry = entryPool.get(bucket.entries[i]);
+            if (entry.matches(key, kSize, hash)) {
+                VersionWrite write(*this, bucket.version);
+                releaseEntry(bucket.entries[i]);
+                --numEntries;
+                bucket.entries[i] = static_cast<uint32_t>(insertEntry(key, value, kSize, vSize, hash, expiresAt));
+                return true;
+            }
+        }
+        if (freeSlot < 0) {
+            auto freeSlots = ctrlMatchFree(bucket.ctrl);
+            if (freeSlots) {
+                freeIdx = idx;
+                freeSlot = ctrlFirst(freeSlots);
             }
-            table[idx].entries[i] = insertEntry(key, value, kSize, vSize);
-            return true;
+        }
+        if (ctrlMatchEmpty(bucket.ctrl)) {
+            chainFull = false;
+            break;
         }
         numCollisions++;
     } while (attempt < MAX_READ_WRITE_ATTEMPTS);
 
+    if (chainFull && numStashed) {
+        int stashSlot;
+        if (auto stashBucket = findStashed(key, kSize, hash, stashSlot)) {
+            VersionWrite write(*this, stashBucket->version);
+            releaseEntry(stashBucket->entries[stashSlot]);
+            --numEntries;
+            stashBucket->entries[stashSlot] = static_cast<uint32_t>(insertEntry(key, value, kSize, vSize, hash, expiresAt));
+            return true;
+        }
+    }
+
+    if (freeSlot < 0 && numStashed == stash.size() * BUCKET_SIZE) {
+        // Stash is full too, grow the table unless keys collide so much that a bigger table would not help
+        if (numEntries * 100 < tableSize * BUCKET_SIZE * OVERFLOW_STASH_MIN_RESIZE_LOAD_PERCENTAGE) {
 #ifndef NDEBUG
-    std::cerr << "Failed to insert key = " << key << " after " << attempt << " attempts.\n";
+            std::cerr << "Failed to insert key = " << std::string_view(key, kSize) << " after " << attempt << " attempts, overflow stash is full.\n";
 #endif
-    return false;
+            return false;
+        }
+        resize();
+        return set(key, kSize, value, vSize, hash, ttlMs);
+    }
+
+    int oldSlot;
+    uint_fast64_t oldIdx;
+    bool inOldTable = oldTable && findSlot(oldTable, oldTableSize, key, kSize, hash, oldIdx, oldSlot);
+    // Key moves from the old table to the new one, concurrent readers must not miss it in between
+    VersionWrite layoutChange(*this, layoutVersion, inOldTable);
+    if (inOldTable) {
+        eraseSlot(oldTable[oldIdx], oldSlot);
+    }
+    auto entryIdx = insertEntry(key, value, kSize, vSize, hash, expiresAt);
+    if (freeSlot < 0) {
+        stashEntry(entryIdx);
+        return true;
+    }
+    VersionWrite write(*this, table[freeIdx].version);
+    if (table[freeIdx].ctrl[freeSlot] == CTRL_DELETED) {
+        --numTombstones;
+    }
+    table[freeIdx].ctrl[freeSlot] = tag;
+    table[freeIdx].entries[freeSlot] = static_cast<uint32_t>(entryIdx);
+    return true;
 }
 
-uint_fast64_t KeyValueStore::insertEntry(const char *key, const char *value, size_t kSize, size_t vSize) {
+uint_fast64_t KeyValueStore::insertEntry(const char *key, const char *value, size_t kSize, size_t vSize, uint_fast64_t hash, uint_fast64_t expiresAt) {
     auto poolEntry = entryPool.allocate();
     auto& allocatedEntry = poolEntry.entry;
-    allocatedEntry.key = new char[kSize];
-    memcpy(allocatedEntry.key, key, kSize);
-
-    if (compressionEnabled && vSize >= MIN_SIZE_TO_COMPRESS) {
-        auto compressed = GzipCompressor::Compress(value);
-        if (compressed.operationResult == 0) {
-            allocatedEntry.value = compressed.data;
-            allocatedEntry.vSize = compressed.size;
-            allocatedEntry.compressed = true;
-        } else {
-            allocatedEntry.value = new char[vSize];
-            allocatedEntry.vSize = vSize;
-            memcpy(allocatedEntry.value, value, vSize);
+    allocatedEntry.hash = hash;
+    allocatedEntry.expiresAt = expiresAt;
+    if (expiresAt) {
+        scheduleExpiration(poolEntry.i);
+    }
+
+    if (compressionEnabled && codec != CodecId::None) {
+        dictionaries.offer(value, vSize);
+        // With background compression the value is stored as is and compressed only once it is not read for a while
+        if (!compressColdAfterMs && compressRecord(allocatedEntry, key, kSize, value, vSize)) {
+            usedMemory += allocatedEntry.memoryUsage();
+            touch(allocatedEntry);
+            ++numEntries;
+            return poolEntry.i;
         }
-    } else {
-        allocatedEntry.value = new char[vSize];
-        allocatedEntry.vSize = vSize;
-        memcpy(allocatedEntry.value, value, vSize);
     }
 
+    auto bytes = allocateRecord(allocatedEntry, kSize, vSize, respFraming);
+    memcpy(bytes, key, kSize);
+    memcpy(allocatedEntry.value(), value, vSize);
+    usedMemory += allocatedEntry.memoryUsage();
+    touch(allocatedEntry);
+
     ++numEntries;
     return poolEntry.i;
 }
 
+/// @brief Allocates entry record with the compressed value if compression saves enough, otherwise leaves the entry untouched
+bool KeyValueStore::compressRecord(Entry &entry, const char *key, size_t kSize, const char *value, size_t vSize) {
+    auto dictionary = dictionaries.current();
+    // Small values do not compress on their own, with a trained dictionary they can refer to content shared by all values
+    bool useDictionary = dictionary && vSize >= DICT_MIN_SIZE_TO_COMPRESS && vSize <= DICT_MAX_VALUE_SIZE;
+    if (!useDictionary && vSize < MIN_SIZE_TO_COMPRESS) {
+        return false;
+    }
+    auto valueCodec = useDictionary ? CodecId::DeflateDict : codec;
+    if (ValueCodec::EstimateSavingsPercent(valueCodec, value, vSize) < minCompressionSavings) {
+        // Random tokens, already compressed data and alike, not worth a compression attempt
+        ++numCompressionSkips;
+        entry.incompressible = true;
+        return false;
+    }
+    auto compressed = ValueCodec::Compress(valueCodec, value, vSize, compressionLevel, dictionary);
+    // Value which saves too little is kept as is, so later reads do not pay for decompression
+    if (compressed.operationResult != 0 || compressed.size >= vSize || compressed.size * 100 > vSize * (100 - minCompressionSavings)) {
+        ++numCompressionRejects;
+        entry.incompressible = true;
+        delete[] compressed.data;
+        return false;
+    }
+    auto bytes = allocateRecord(entry, kSize, compressed.size);
+    memcpy(bytes, key, kSize);
+    memcpy(bytes + kSize, compressed.data, compressed.size);
+    entry.codec = valueCodec;
+    if (useDictionary) {
+        dictionaries.acquire(dictionary->id);
+    }
+    delete[] compressed.data;
+    return true;
+}
+
+/// @brief Compresses values which were not read for compressColdAfterMs, walking the entry pool a batch at a time
+void KeyValueStore::compressColdEntries() {
+    clockMs = monotonicMsec();
+    auto capacity = entryPool.getCapacity();
+    uint_fast32_t numCompressed = 0;
+    for (uint_fast32_t scanned = 0; scanned < COLD_COMPRESSION_SCAN_BATCH && numCompressed < COLD_COMPRESSION_BATCH; ++scanned) {
+        if (coldCompressionCursor >= capacity) {
+            coldCompressionCursor = 1;
+        }
+        auto &entry = entryPool.get(coldCompressionCursor++);
+        // Inline records are too small to compress
+        if (entry.isInline || !entry.data || entry.codec != CodecId::None || entry.incompressible
+            || entry.isExpired(clockMs) || idleMs(entry, clockMs) < compressColdAfterMs) {
+            continue;
+        }
+        // Bucket of the entry is not known here, concurrent readers retry on any change of the layout instead
+        VersionWrite layoutChange(*this, layoutVersion);
+        auto oldData = entry.data;
+        auto oldRecordSize = entry.recordSize();
+        auto oldMemoryUsage = entry.memoryUsage();
+        if (compressRecord(entry, oldData, entry.kSize, entry.value(), entry.vSize)) {
+            freeRecord(oldData, oldRecordSize);
+            usedMemory = usedMemory - oldMemoryUsage + entry.memoryUsage();
+            ++numColdCompressions;
+            ++numCompressed;
+        }
+    }
+}
+
+/// @brief Replaces compressed value of an entry which is read again with its decompressed bytes, keeps the entry compressed if that would exceed the memory limit
+void KeyValueStore::decompressInPlace(uint32_t entryIdx) {
+    auto &entry = entryPool.get(entryIdx);
+    auto dictionary = entry.codec == CodecId::DeflateDict ? dictionaries.find(DictionaryCompressor::DictionaryId(entry.value())) : nullptr;
+    auto decompressed = ValueCodec::Decompress(entry.codec, entry.value(), entry.vSize, dictionary);
+    if (decompressed.operationResult != 0) {
+        return;
+    }
+    auto oldMemoryUsage = entry.memoryUsage();
+    auto newRecordSize = recordSizeOf(entry.kSize, decompressed.size);
+    auto newMemoryUsage = sizeof(Entry) + (newRecordSize <= ENTRY_INLINE_CAPACITY ? 0 : newRecordSize);
+    if (maxMemory && usedMemory - oldMemoryUsage + newMemoryUsage > maxMemory) {
+        delete[] decompressed.data;
+        return;
+    }
+    if (entry.codec == CodecId::DeflateDict) {
+        dictionaries.release(DictionaryCompressor::DictionaryId(entry.value()));
+    }
+    // Well compressed small values may be inline, their key has to be saved before the record is reallocated
+    auto wasInline = entry.isInline;
+    char inlineKey[ENTRY_INLINE_CAPACITY];
+    const char *oldKey = entry.key();
+    if (wasInline) {
+        memcpy(inlineKey, entry.inlineData, entry.kSize);
+        oldKey = inlineKey;
+    }
+    auto oldData = entry.data;
+    auto oldRecordSize = entry.recordSize();
+    auto bytes = allocateRecord(entry, entry.kSize, decompressed.size, respFraming);
+    memcpy(bytes, oldKey, entry.kSize);
+    memcpy(entry.value(), decompressed.data, decompressed.size);
+    entry.codec = CodecId::None;
+    valueCache.erase(entryIdx);
+    if (!wasInline) {
+        freeRecord(oldData, oldRecordSize);
+    }
+    usedMemory = usedMemory - oldMemoryUsage + entry.memoryUsage();
+    ++numHotDecompressions;
+    delete[] decompressed.data;
+}
+
 const char* KeyValueStore::get(const char *key) {
-    auto primaryHash = hashFunc(key);
-    return get(key, primaryHash);
+    return get(key, strlen(key)).data;
 }
 
-const char* KeyValueStore::get(const char *key, uint_fast64_t hash) {
-    uint_fast64_t attempt = 0, idx;
-    do {
-        idx = calcIndex(hash, attempt++, tableSize);
-        for (int i = 0; i < BUCKET_SIZE; ++i) {
-            auto entryIdx = table[idx].entries[i];
-            if (!entryIdx) {
-                continue;
-            }
+ValueView KeyValueStore::get(const char *key, size_t kSize) {
+    return get(key, kSize, hashFunc(key, kSize));
+}
 
-            auto entry = entryPool.get(entryIdx);
-            if (!entry.key) {
-                continue;
-            }
+ValueView KeyValueStore::get(const char *key, size_t kSize, uint_fast64_t hash) {
+    if (oldTable) {
+        migrateBuckets(migrationBatchSize);
+    }
+    int slot;
+    auto bucket = locateLive(key, kSize, hash, slot);
+    if (!bucket) {
+        return ValueView{};
+    }
+    auto entryIdx = bucket->entries[slot];
+    auto &entry = entryPool.get(entryIdx);
+    touch(entry);
+    if (entry.codec != CodecId::None && compressColdAfterMs) {
+        VersionWrite write(*this, bucket->version);
+        decompressInPlace(entryIdx);
+    }
+    return entry.codec != CodecId::None ? decompressEntry(entryIdx) : ValueView{ entry.value(), entry.vSize, !entry.isInline, entry.respHeaderSize };
+}
+
+inline ValueView KeyValueStore::decompressEntry(uint32_t entryIdx) {
+    auto cached = valueCache.find(entryIdx);
+    if (cached.data()) {
+        return ValueView{ cached.data(), cached.size() };
+    }
+    auto &entry = entryPool.get(entryIdx);
+    auto dictionary = entry.codec == CodecId::DeflateDict ? dictionaries.find(DictionaryCompressor::DictionaryId(entry.value())) : nullptr;
+    auto decompressed = ValueCodec::Decompress(entry.codec, entry.value(), entry.vSize, dictionary);
+    if (decompressed.operationResult != 0) {
+        return ValueView{};
+    }
+    cached = valueCache.insert(entryIdx, decompressed.data, decompressed.size);
+    if (cached.data()) {
+        return ValueView{ cached.data(), cached.size() };
+    }
+    // Value larger than the whole cache is owned by the store until the next one like it is read
+    uncachedValue.reset(decompressed.data);
+    return ValueView{ decompressed.data, decompressed.size };
+}
+
+ReadResult KeyValueStore::readConcurrent(const char *key, size_t kSize, uint_fast64_t hash, std::string &value) const {
+    if (!concurrentReads) {
+        return ReadResult::Conflict;
+    }
+    EpochManager::ReadGuard guard(EpochManager::shared());
+    if (!guard) {
+        return ReadResult::Conflict;
+    }
+    for (int attempt = 0; attempt < CONCURRENT_READ_ATTEMPTS; ++attempt) {
+        if (auto result = tryReadConcurrent(key, kSize, hash, value)) {
+            return *result;
+        }
+    }
+    return ReadResult::Conflict;
+}
+
+/// @brief Single lookup attempt of readConcurrent(), follows locate() on copies validated against bucket and layout versions
+/// @return Empty if a write overlapped with it and it has to be restarted
+std::optional<ReadResult> KeyValueStore::tryReadConcurrent(const char *key, size_t kSize, uint_fast64_t hash, std::string &value) const {
+    auto layout = loadVersion(layoutVersion, std::memory_order_acquire);
+    if (layout & 1) {
+        return std::nullopt;
+    }
+    // Table pointers and sizes have to be consistent with each other before any bucket is indexed
+    auto *tbl = std::atomic_ref<Bucket*>(const_cast<Bucket*&>(table)).load(std::memory_order_relaxed);
+    auto size = std::atomic_ref<uint_fast64_t>(const_cast<uint_fast64_t&>(tableSize)).load(std::memory_order_relaxed);
+    auto *oldTbl = std::atomic_ref<Bucket*>(const_cast<Bucket*&>(oldTable)).load(std::memory_order_relaxed);
+    auto oldSize = std::atomic_ref<uint_fast64_t>(const_cast<uint_fast64_t&>(oldTableSize)).load(std::memory_order_relaxed);
+    auto *stashBuckets = stash.data();
+    auto stashSize = stash.size();
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (loadVersion(layoutVersion, std::memory_order_relaxed) != layout) {
+        return std::nullopt;
+    }
 
-            if (strcmp(entry.key, key) == 0) {
-                return entry.compressed ? decompressEntry(entry) : entry.value;
+    bool chainFull = false;
+    auto result = probeConcurrent(tbl, size, layout, key, kSize, hash, value, chainFull);
+    if (result != ReadResult::NotFound) {
+        return result;
+    }
+    if (oldTbl) {
+        bool oldChainFull = false;
+        result = probeConcurrent(oldTbl, oldSize, layout, key, kSize, hash, value, oldChainFull);
+        if (result != ReadResult::NotFound) {
+            return result;
+        }
+    }
+    if (chainFull) {
+        bool unused;
+        for (size_t i = 0; i < stashSize; ++i) {
+            result = matchConcurrent(stashBuckets[i], layout, key, kSize, hash, value, unused);
+            if (result != ReadResult::NotFound) {
+                return result;
             }
         }
-    } while (attempt < MAX_READ_WRITE_ATTEMPTS);
+    }
+    // Buckets were consistent one by one, an unchanged layout means the key did not move between them meanwhile
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (loadVersion(layoutVersion, std::memory_order_relaxed) != layout) {
+        return std::nullopt;
+    }
+    return ReadResult::NotFound;
+}
 
-    return nullptr;
+std::optional<ReadResult> KeyValueStore::probeConcurrent(const Bucket *tbl, uint_fast64_t size, uint32_t layout, const char *key, size_t kSize, uint_fast64_t hash,
+                                                         std::string &value, bool &chainFull) const {
+    for (int attempt = 0; attempt < MAX_READ_WRITE_ATTEMPTS; ++attempt) {
+        bool hasEmpty = false;
+        auto result = matchConcurrent(tbl[calcIndex(hash, attempt, size)], layout, key, kSize, hash, value, hasEmpty);
+        if (result != ReadResult::NotFound || hasEmpty) {
+            return result;
+        }
+    }
+    chainFull = true;
+    return ReadResult::NotFound;
 }
 
-inline const char* KeyValueStore::decompressEntry(const Entry &entry) {
-    auto decompressed = GzipCompressor::Decompress(entry.value, entry.vSize);
-    return decompressed.operationResult == 0 ? decompressed.data : nullptr;
+/// @brief Looks the key up in a single bucket. Entry headers are copied and validated before their records are touched,
+/// records are never modified in place and retired ones outlive the reader's epoch, so a validated record can be read as is
+/// @param hasEmpty set to true if the bucket has an empty slot, which ends the probe sequence
+std::optional<ReadResult> KeyValueStore::matchConcurrent(const Bucket &bucket, uint32_t layout, const char *key, size_t kSize, uint_fast64_t hash,
+                                                         std::string &value, bool &hasEmpty) const {
+    auto version = loadVersion(bucket.version, std::memory_order_acquire);
+    if (version & 1) {
+        return std::nullopt;
+    }
+    uint8_t ctrl[BUCKET_SIZE];
+    uint32_t entries[BUCKET_SIZE];
+    memcpy(ctrl, bucket.ctrl, sizeof(ctrl));
+    memcpy(entries, bucket.entries, sizeof(entries));
+    auto isUnchanged = [&]() {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return loadVersion(bucket.version, std::memory_order_relaxed) == version && loadVersion(layoutVersion, std::memory_order_relaxed) == layout;
+    };
+    if (!isUnchanged()) {
+        return std::nullopt;
+    }
+
+    for (auto matched = ctrlMatch(ctrl, ctrlTag(hash)); matched; matched &= matched - 1) {
+        Entry entry;
+        memcpy(static_cast<void*>(&entry), &entryPool.get(entries[ctrlFirst(matched)]), sizeof(Entry));
+        if (!isUnchanged()) {
+            return std::nullopt;
+        }
+        if (!entry.matches(key, kSize, hash)) {
+            continue;
+        }
+        if (entry.expiresAt && entry.isExpired(monotonicMsec())) {
+            return ReadResult::NotFound;
+        }
+        if (entry.codec == CodecId::None) {
+            value.assign(entry.value(), entry.vSize);
+            return ReadResult::Found;
+        }
+        // Dictionaries belong to the writer
+        if (entry.codec == CodecId::DeflateDict) {
+            return ReadResult::Conflict;
+        }
+        auto decompressed = ValueCodec::Decompress(entry.codec, entry.value(), entry.vSize);
+        if (decompressed.operationResult != 0) {
+            return ReadResult::Conflict;
+        }
+        value.assign(decompressed.data, decompressed.size);
+        delete[] decompressed.data;
+        return ReadResult::Found;
+    }
+    hasEmpty = ctrlMatchEmpty(ctrl) != 0;
+    return ReadResult::NotFound;
 }
 
 bool kvs::KeyValueStore::del(const char *key)
 {
-    auto primaryHash = hashFunc(key);
-    return del(key, primaryHash);
+    return del(key, strlen(key));
 }
 
-bool kvs::KeyValueStore::del(const char *key, uint_fast64_t hash)
+bool kvs::KeyValueStore::del(const char *key, size_t kSize)
 {
-    // TODO: consider shrinking in future
-    uint_fast64_t attempt = 0, idx;
-    auto kSize = strlen(key) + 1;
+    return del(key, kSize, hashFunc(key, kSize));
+}
 
-    do {
-        idx = calcIndex(hash, attempt++, tableSize);
-        for (int i = 0; i < BUCKET_SIZE; ++i) {
-            auto entryIdx = table[idx].entries[i];
-            if (!entryIdx) {
-                continue;
+bool kvs::KeyValueStore::del(const char *key, size_t kSize, uint_fast64_t hash)
+{
+    if (oldTable) {
+        migrateBuckets(migrationBatchSize);
+    }
+    int slot;
+    auto bucket = locateLive(key, kSize, hash, slot);
+    if (!bucket) {
+#ifndef NDEBUG
+        std::cerr << "Failed to find key during deletion, key = " << std::string_view(key, kSize) << std::endl;
+#endif
+        return false;
+    }
+
+    eraseSlot(*bucket, slot);
+    shrinkIfSparse();
+    return true;
+}
+
+void KeyValueStore::scheduleExpiration(uint_fast64_t entryIdx) {
+    auto &entry = entryPool.get(entryIdx);
+    expirations.schedule(TimerRecord{ entry.expiresAt, entry.hash, static_cast<uint32_t>(entryIdx) });
+}
+
+bool KeyValueStore::removeExpired(uint_fast32_t maxRecords) {
+    auto now = monotonicMsec();
+    dueExpirations.clear();
+    auto pending = expirations.advance(now, dueExpirations, maxRecords);
+    for (auto &record : dueExpirations) {
+        if (record.entryIdx >= entryPool.getCapacity()) {
+            // Entry was moved by shrinking and its old index released
+            continue;
+        }
+        auto &entry = entryPool.get(record.entryIdx);
+        // Entry could be overwritten, persisted or deleted since the record was scheduled
+        if (entry.expiresAt != record.expiresAt || entry.hash != record.hash || !entry.isExpired(now)) {
+            continue;
+        }
+        int slot;
+        auto bucket = locate(entry.key(), entry.kSize, entry.hash, slot);
+        if (bucket && bucket->entries[slot] == record.entryIdx) {
+            eraseSlot(*bucket, slot);
+            ++numExpired;
+        }
+    }
+    shrinkIfSparse();
+    return pending;
+}
+
+bool KeyValueStore::expire(const char *key, size_t kSize, uint_fast64_t hash, int_fast64_t ttlMs) {
+    int slot;
+    auto bucket = locateLive(key, kSize, hash, slot);
+    if (!bucket) {
+        return false;
+    }
+    if (ttlMs <= 0) {
+        eraseSlot(*bucket, slot);
+        return true;
+    }
+    auto entryIdx = bucket->entries[slot];
+    VersionWrite write(*this, bucket->version);
+    entryPool.get(entryIdx).expiresAt = monotonicMsec() + static_cast<uint_fast64_t>(ttlMs);
+    scheduleExpiration(entryIdx);
+    return true;
+}
+
+int_fast64_t KeyValueStore::ttl(const char *key, size_t kSize, uint_fast64_t hash) {
+    int slot;
+    auto bucket = locateLive(key, kSize, hash, slot);
+    if (!bucket) {
+        return TTL_KEY_NOT_FOUND;
+    }
+    auto &entry = entryPool.get(bucket->entries[slot]);
+    if (!entry.expiresAt) {
+        return TTL_NO_EXPIRY;
+    }
+    return static_cast<int_fast64_t>(entry.expiresAt - monotonicMsec());
+}
+
+bool KeyValueStore::persist(const char *key, size_t kSize, uint_fast64_t hash) {
+    int slot;
+    auto bucket = locateLive(key, kSize, hash, slot);
+    if (!bucket) {
+        return false;
+    }
+    auto &entry = entryPool.get(bucket->entries[slot]);
+    if (!entry.expiresAt) {
+        return false;
+    }
+    VersionWrite write(*this, bucket->version);
+    entry.expiresAt = 0;
+    return true;
+}
+
+inline uint_fast64_t KeyValueStore::nextRandom() noexcept {
+    // xorshift64*
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545F4914F6CDD1Dull;
+}
+
+inline uint_fast64_t KeyValueStore::accessClock() noexcept {
+    if ((++numAccesses & (ACCESS_CLOCK_REFRESH_OPS - 1)) == 0) {
+        clockMs = monotonicMsec();
+    }
+    return clockMs;
+}
+
+inline uint8_t KeyValueStore::lfuCounter(uint16_t access, uint_fast64_t nowMs) const noexcept {
+    auto counter = static_cast<uint8_t>(access & 0xFF);
+    auto elapsedMin = static_cast<uint8_t>(nowMs / 60000 - (access >> 8));
+    auto periods = elapsedMin / LFU_DECAY_TIME_MIN;
+    return periods >= counter ? 0 : static_cast<uint8_t>(counter - periods);
+}
+
+inline void KeyValueStore::touch(Entry &entry) noexcept {
+    // Access time is needed by eviction and background compression only
+    if (!maxMemory && !compressColdAfterMs) {
+        return;
+    }
+    auto now = accessClock();
+    switch (evictionPolicy) {
+        case EvictionPolicy::LRU:
+        case EvictionPolicy::NoEviction:
+            entry.access = static_cast<uint16_t>(now / LRU_CLOCK_RESOLUTION_MS);
+            break;
+        case EvictionPolicy::LFU: {
+            // New entries have access == 0, they start at LFU_INIT_VAL instead of decaying from 0
+            uint8_t counter = entry.access ? lfuCounter(entry.access, now) : LFU_INIT_VAL;
+            if (entry.access && counter < UINT8_MAX) {
+                // Logarithmic counter, the more accesses the less likely the increment
+                auto base = counter > LFU_INIT_VAL ? counter - LFU_INIT_VAL : 0;
+                if (nextRandom() % (base * LFU_LOG_FACTOR + 1) == 0) {
+                    ++counter;
+                }
             }
+            entry.access = static_cast<uint16_t>(((now / 60000) & 0xFF) << 8 | counter);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+inline uint_fast64_t KeyValueStore::idleMs(const Entry &entry, uint_fast64_t nowMs) const noexcept {
+    if (evictionPolicy == EvictionPolicy::LFU) {
+        // LFU keeps the minute of the last access in the high byte
+        return static_cast<uint_fast64_t>(static_cast<uint8_t>(nowMs / 60000 - (entry.access >> 8))) * 60000;
+    }
+    return static_cast<uint_fast64_t>(static_cast<uint16_t>(nowMs / LRU_CLOCK_RESOLUTION_MS - entry.access)) * LRU_CLOCK_RESOLUTION_MS;
+}
+
+inline uint_fast64_t KeyValueStore::evictionScore(const Entry &entry, uint_fast64_t nowMs) const noexcept {
+    if (evictionPolicy == EvictionPolicy::LFU) {
+        return UINT8_MAX - lfuCounter(entry.access, nowMs);
+    }
+    // Idle time, the clock wraps so the difference is taken modulo 2^16
+    return static_cast<uint16_t>(nowMs / LRU_CLOCK_RESOLUTION_MS - entry.access);
+}
+
+bool KeyValueStore::reserveMemory(size_t kSize, size_t vSize) {
+    auto recordSize = recordSizeOf(kSize, vSize);
+    auto required = sizeof(Entry) + (recordSize <= ENTRY_INLINE_CAPACITY ? 0 : recordSize);
+    if (required > maxMemory) {
+        return false;
+    }
+    while (usedMemory + required > maxMemory) {
+        if (evictionPolicy == EvictionPolicy::NoEviction || !evictOne()) {
+            return false;
+        }
+    }
+    return true;
+}
 
-            auto entry = entryPool.get(entryIdx);
-            if (!entry.key) {
+bool KeyValueStore::evictOne() {
+    if (!numEntries) {
+        return false;
+    }
+    clockMs = monotonicMsec();
+    Bucket *victimBucket = nullptr;
+    int victimSlot = -1;
+    uint_fast64_t victimScore = 0;
+    uint_fast32_t samples = 0;
+
+    auto sampleBucket = [&](Bucket &bucket) -> bool {
+        for (int j = 0; j < BUCKET_SIZE; ++j) {
+            if (!ctrlIsFull(bucket.ctrl[j])) {
                 continue;
             }
-
-            if (strcmp(entry.key, key) == 0) {
-                entryPool.deallocate(entryIdx);
+            auto &entry = entryPool.get(bucket.entries[j]);
+            if (entry.isExpired(clockMs)) {
+                // Expired key is the best victim, no need to look further
+                eraseSlot(bucket, j);
+                ++numExpired;
                 return true;
             }
+            auto score = evictionScore(entry, clockMs);
+            if (!victimBucket || score > victimScore) {
+                victimBucket = &bucket;
+                victimSlot = j;
+                victimScore = score;
+            }
+            ++samples;
         }
-    } while (attempt < MAX_READ_WRITE_ATTEMPTS);
+        return false;
+    };
 
-#ifndef NDEBUG
-    std::cerr << "Failed to find key during deletion, key = " << key << " after " << attempt << " attempts.\n";
-#endif
-    return false;
+    // Buckets of the table, the old table and the stash are numbered in this order, stashed keys have to be evictable too
+    auto numOldBuckets = oldTable ? oldTableSize : 0;
+    auto totalBuckets = tableSize + numOldBuckets + stash.size();
+    auto bucketAt = [&](uint_fast64_t idx) -> Bucket& {
+        if (idx < tableSize) {
+            return table[idx];
+        }
+        idx -= tableSize;
+        return idx < numOldBuckets ? oldTable[idx] : stash[idx - numOldBuckets];
+    };
+    for (uint_fast32_t probe = 0; samples < evictionSamples && probe < evictionSamples * EVICTION_BUCKET_PROBES_PER_SAMPLE; ++probe) {
+        if (sampleBucket(bucketAt(nextRandom() % totalBuckets))) {
+            return true;
+        }
+    }
+
+    // Sparse table, fall back to scanning from a random position
+    for (uint_fast64_t i = 0, start = nextRandom() % totalBuckets; !victimBucket && i < totalBuckets; ++i) {
+        if (sampleBucket(bucketAt((start + i) % totalBuckets))) {
+            return true;
+        }
+    }
+
+    if (!victimBucket) {
+        return false;
+    }
+    ++numEvictions;
+    evictedBytes += entryPool.get(victimBucket->entries[victimSlot]).memoryUsage();
+    eraseSlot(*victimBucket, victimSlot);
+    return true;
 }
@@ -2,7 +2,9 @@
 #include <cstdint>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <vector>
 #include <cstdio>
 #include <string.h>
 #include <charconv>
@@ -12,39 +14,220 @@
 #include <algorithm>
 #include <future>
 #include <atomic>
+#include <optional>
 #include "../primegen/primegen.hpp"
 #include "../hash/hash.hpp"
 #include "../non_copyable.hpp"
-#include "../compressor/gzip_compressor.hpp"
+#include "../compressor/codec.hpp"
+#include "ctrl_group.hpp"
+#include "slab_allocator.hpp"
+#include "timing_wheel.hpp"
+#include "value_cache.hpp"
+#include "helper_pool.hpp"
+#include "epoch.hpp"
+#include "../utils/time.hpp"
 
 #ifndef NDEBUG
 #include <chrono>
 #endif
 
 #define UNIT_SEPARATOR 0x1F
-#define BUCKET_SIZE 4
+#define BUCKET_SIZE 8
 #define MIN_SIZE_TO_COMPRESS 30
-#define MAX_READ_WRITE_ATTEMPTS 5
-#define RESIZE_THRESHOLD_PERCENTAGE 70
+/// @brief Values which compress by less than this percentage are stored as is
+#define MIN_COMPRESSION_SAVINGS_PERCENT 10
+/// @brief Max number of buckets probed for a key, lookups stop earlier at the first bucket with an empty slot
+#define MAX_READ_WRITE_ATTEMPTS 12
+/// @brief Table grows when keys and tombstones occupy this percentage of its slots
+#define RESIZE_THRESHOLD_PERCENTAGE 87
+/// @brief Table shrinks when its load (share of occupied slots) drops below this percentage
+#define SHRINK_THRESHOLD_PERCENTAGE 10
+/// @brief Max load right after shrinking, kept well below RESIZE_THRESHOLD_PERCENTAGE so a few inserts do not grow the table back
+#define SHRINK_TARGET_LOAD_PERCENTAGE 35
+/// @brief Overflow stash has a bucket per this many table buckets, keys whose whole probe sequence is full are kept there
+#define OVERFLOW_STASH_TABLE_RATIO 512
+#define OVERFLOW_STASH_MIN_BUCKETS 4
+/// @brief Full stash grows the table only above this load, below it keys collide too much for a bigger table to help and the insert fails
+#define OVERFLOW_STASH_MIN_RESIZE_LOAD_PERCENTAGE 50
+#define ENTRY_INLINE_CAPACITY 23
+/// @brief Entry pool grows and shrinks by segments of 2^POOL_SEGMENT_BITS entries (256KB)
+#define POOL_SEGMENT_BITS 12
+/// @brief Number of segments needed to address every 32 bit entry index
+#define POOL_MAX_SEGMENTS ((uint_fast64_t(1) << 32) >> POOL_SEGMENT_BITS)
+/// @brief ttl() result for a key without expiration
+#define TTL_NO_EXPIRY -1
+/// @brief ttl() result for a missing (or already expired) key
+#define TTL_KEY_NOT_FOUND -2
+/// @brief Resolution of the LRU access clock, 16 bit clock wraps after ~18 hours
+#define LRU_CLOCK_RESOLUTION_MS 1000
+/// @brief Access clock is re-read from the OS once per this many accesses, must be a power of two
+#define ACCESS_CLOCK_REFRESH_OPS 256
+/// @brief Starting LFU counter of a new key, so new keys are not evicted right away
+#define LFU_INIT_VAL 5
+/// @brief Higher values require more accesses to increment the logarithmic LFU counter
+#define LFU_LOG_FACTOR 10
+/// @brief LFU counter is decremented once per this many minutes without access
+#define LFU_DECAY_TIME_MIN 1
+/// @brief Max number of random buckets probed per eviction, per requested sample
+#define EVICTION_BUCKET_PROBES_PER_SAMPLE 4
+/// @brief Max number of entries examined by a single background compression pass
+#define COLD_COMPRESSION_SCAN_BATCH 256
+/// @brief Max number of values compressed by a single background compression pass
+#define COLD_COMPRESSION_BATCH 16
+/// @brief Blocking resize of a table with fewer buckets migrates them on the calling thread only
+#define PARALLEL_REHASH_MIN_BUCKETS 16384
+/// @brief Number of old table buckets a rehash thread takes at a time
+#define PARALLEL_REHASH_CHUNK_BUCKETS 4096
+/// @brief Number of times a concurrent read is restarted because of writes to what it read, before it gives up and leaves the key to the writer's thread
+#define CONCURRENT_READ_ATTEMPTS 8
+/// @brief Records freed while concurrent readers may still use them are released in batches of this size, once all readers have left their epoch
+#define RETIRED_RECORDS_RECLAIM_BATCH 64
 
 namespace kvs
 {
+    /// @brief What to do when a write would exceed the memory limit
+    enum class EvictionPolicy : uint8_t {
+        /// @brief Reject writes
+        NoEviction = 0,
+        /// @brief Evict approximately least recently used key
+        LRU = 1,
+        /// @brief Evict approximately least frequently used key
+        LFU = 2,
+    };
+
     struct KeyValueStoreSettings {
         uint_fast64_t initialSize = 2053;
         bool compressionEnabled = true;
+        /// @brief Grow through prime table sizes and index buckets by modulo, otherwise sizes are powers of two (initialSize is rounded up) and buckets are indexed by the low hash bits
         bool usePrimeNumbers = true;
+        /// @brief Keep old and new tables live during resize and migrate buckets gradually instead of one stop-the-world pass
+        bool incrementalResize = true;
+        /// @brief Number of old table buckets migrated per operation (and per maintenance call) during incremental resize
+        uint_fast32_t migrationBatchSize = 8;
+        /// @brief Shrink table and entry pool when most of the keys are deleted
+        bool shrinkEnabled = true;
+        /// @brief Max memory used by entries, keys and values in bytes, 0 - unlimited
+        uint_fast64_t maxMemory = 0;
+        EvictionPolicy evictionPolicy = EvictionPolicy::LRU;
+        /// @brief Number of keys sampled to pick an eviction victim, more samples - better approximation, slower eviction
+        uint_fast32_t evictionSamples = 5;
+        /// @brief zlib level of value compression, 1 - fastest, 9 - best ratio
+        int compressionLevel = GZIP_DEFAULT_LEVEL;
+        /// @brief Codec of values written when compressionEnabled is set
+        CodecId codec = CodecId::Lz4;
+        /// @brief Size of the deflate dictionary trained from sampled values, small values are compressed with it once it is trained. 0 - disabled
+        size_t dictionarySize = 0;
+        /// @brief Min percentage of value size compression has to save, otherwise the value is stored as is. Values estimated to save less are not even compressed
+        uint_fast32_t minCompressionSavings = MIN_COMPRESSION_SAVINGS_PERCENT;
+        /// @brief Store values as is and let maintenance compress values not read for this long, compressed values are decompressed in place
+        /// once read again. Idle time is tracked with LRU_CLOCK_RESOLUTION_MS resolution (minutes with LFU eviction). 0 - compress on write
+        uint_fast64_t compressColdAfterMs = 0;
+        /// @brief Max bytes of decompressed values cached for repeated reads of compressed values, 0 - disabled
+        size_t valueCacheSize = VALUE_CACHE_DEFAULT_SIZE;
+        /// @brief Store uncompressed values framed as RESP bulk strings, so they can be sent to RESP clients without encoding. Costs 5+ bytes per value
+        bool respFraming = false;
+        /// @brief Threads (including the calling one) migrating keys during a blocking resize, helpers come from HelperPool::shared(). 1 - migrate on the calling thread only
+        uint_fast32_t rehashThreads = 1;
+        /// @brief Allow readConcurrent() from other threads while a single thread modifies the store. Writers then mark what they change for the readers
+        /// and free records only after the readers which could see them are done. Reserves address space to index the whole entry pool (8MB, touched as the pool grows)
+        bool concurrentReads = false;
+    };
+
+    /// @brief Outcome of KeyValueStore::readConcurrent()
+    enum class ReadResult : uint8_t {
+        Found = 0,
+        NotFound = 1,
+        /// @brief Read kept overlapping with writes, or the value needs the writer's state (e.g. dictionary compressed value). Use get() on the writer's thread
+        Conflict = 2,
     };
 
+    /// @brief Binary safe view of a stored value, data is also zero terminated (framed values are followed by CRLF and then zero). Valid until the next modification of the store,
+    /// views of compressed values are valid until the next get() only
+    struct ValueView {
+        const char *data = nullptr;
+        size_t size = 0;
+        /// @brief Value is a stored record, KeyValueStore::pin() keeps it valid across modifications of the store
+        bool pinnable = false;
+        /// @brief Length of the RESP bulk string header stored right before data, 0 - value is not framed
+        uint8_t respHeaderSize = 0;
+
+        /// @brief Value with its stored RESP bulk string framing, ready to be sent as is. Empty if the value is not framed
+        std::string_view respFrame() const noexcept {
+            return respHeaderSize ? std::string_view(data - respHeaderSize, respHeaderSize + size + 2) : std::string_view{};
+        }
+
+        explicit operator bool() const noexcept {
+            return data != nullptr;
+        }
+    };
+
+    /// @brief Record header, key bytes are immediately followed by value bytes and a zero terminator either in inlineData (small records) or in a single slab allocation
     struct alignas(64) Entry {
-        char *key = nullptr;
-        char *value = nullptr;
-        size_t vSize = 0;
-        bool compressed = false;
-        size_t nextFree = 0;
+        char *data = nullptr;
+        /// @brief Full key hash, reused by resize and compared before any key bytes
+        uint_fast64_t hash = 0;
+        /// @brief Monotonic expiration time in milliseconds, 0 - never expires
+        uint_fast64_t expiresAt = 0;
+        uint32_t kSize = 0;
+        uint32_t vSize = 0;
+        uint32_t nextFree = 0;
+        /// @brief Codec the value bytes are encoded with
+        CodecId codec = CodecId::None;
+        bool isInline : 1 = false;
+        /// @brief Value was not worth compressing, background compression does not try it again
+        bool incompressible : 1 = false;
+        /// @brief Length of the RESP bulk string header stored between key and value, the value is then followed by CRLF. 0 - value is stored without framing
+        uint8_t respHeaderSize : 5 = 0;
+        /// @brief LRU: access clock, LFU: last decrement time in minutes (high byte) and logarithmic access counter (low byte)
+        uint16_t access = 0;
+        char inlineData[ENTRY_INLINE_CAPACITY];
+
+        char* bytes() noexcept {
+            return isInline ? inlineData : data;
+        }
+
+        const char* bytes() const noexcept {
+            return isInline ? inlineData : data;
+        }
+
+        const char* key() const noexcept {
+            return bytes();
+        }
+
+        const char* value() const noexcept {
+            return bytes() + kSize + respHeaderSize;
+        }
+
+        char* value() noexcept {
+            return bytes() + kSize + respHeaderSize;
+        }
+
+        /// @brief Number of bytes occupied by key, value, RESP framing if any and zero terminator
+        size_t recordSize() const noexcept {
+            return kSize + vSize + 1 + (respHeaderSize ? respHeaderSize + 2 : 0);
+        }
+
+        bool matches(const char *otherKey, size_t otherKSize, uint_fast64_t otherHash) const noexcept {
+            return hash == otherHash && kSize == otherKSize && memcmp(key(), otherKey, otherKSize) == 0;
+        }
+
+        /// @brief Memory accounted against the memory limit: entry header and record unless it is stored inline
+        size_t memoryUsage() const noexcept {
+            return sizeof(Entry) + (isInline ? 0 : recordSize());
+        }
+
+        bool isExpired(uint_fast64_t nowMs) const noexcept {
+            return expiresAt != 0 && expiresAt <= nowMs;
+        }
     };
+    static_assert(sizeof(Entry) == 64, "Entry must fit into a single cache line");
 
+    /// @brief Group of slots, control bytes are matched with a single SIMD compare before any entry is touched
     struct alignas(64) Bucket {
-        uint_fast64_t entries[BUCKET_SIZE];
+        uint8_t ctrl[BUCKET_SIZE];
+        uint32_t entries[BUCKET_SIZE];
+        /// @brief Seqlock of concurrent reads, odd while the bucket or one of its entries is being modified
+        uint32_t version;
     };
 
     struct alignas(64) PoolEntry {
@@ -53,66 +236,128 @@ namespace kvs
     };
 
     
+    /// @brief Entry pool made of fixed-size segments, growing appends a segment and never moves existing entries, so references stay valid
     class MemoryPool : NonCopyableOrMovable {
         private:
-            Entry *pool;
-            size_t capacity;
+            static constexpr size_t SEGMENT_SIZE = size_t(1) << POOL_SEGMENT_BITS;
+            static constexpr size_t SEGMENT_MASK = SEGMENT_SIZE - 1;
+
+            std::vector<std::unique_ptr<Entry[]>> segments;
+            size_t capacity = 0;
             std::atomic<size_t> freeListHead;
-            Primegen primegen;
-        public:
-            explicit MemoryPool(size_t initialSize) 
-                : capacity(initialSize), freeListHead(0) {
-                pool = new Entry[capacity];
-                for (size_t i = 1; i < capacity - 1; ++i) {
-                    pool[i].nextFree = i + 1;
+            /// @brief Entries at and above it are not put back to the free list, used while the pool is being shrunk
+            size_t allocationLimit = 0;
+
+            /// @brief Appends a segment and puts its entries in front of the free list
+            void addSegment() {
+                auto *segment = new Entry[SEGMENT_SIZE];
+                size_t first = capacity == 0 ? 1 : capacity; // Index 0 is reserved as the end of the free list
+                for (size_t i = first; i < capacity + SEGMENT_SIZE - 1; ++i) {
+                    segment[i & SEGMENT_MASK].nextFree = static_cast<uint32_t>(i + 1);
                 }
-                pool[capacity - 1].nextFree = 0;
-                freeListHead = 1;
+                segment[SEGMENT_MASK].nextFree = static_cast<uint32_t>(freeListHead);
+                segments.emplace_back(segment);
+                freeListHead = first;
+                capacity += SEGMENT_SIZE;
+                allocationLimit = capacity;
             }
-        
-            ~MemoryPool() {
-                delete[] pool;
+
+        public:
+            explicit MemoryPool(size_t initialSize) : freeListHead(0) {
+                expandPool(initialSize);
             }
-        
+
             PoolEntry allocate() {
                 if (freeListHead == 0) {
-                    auto newCapacity = primegen.PopNext();
-                    expandPool(newCapacity);
+                    addSegment();
                 }
                 size_t i = freeListHead;
-                freeListHead = pool[i].nextFree;
-                return PoolEntry { i, pool[i] };
+                auto &entry = get(i);
+                freeListHead = entry.nextFree;
+                return PoolEntry { i, entry };
             }
 
+            /// @brief Returns entry to the free list, key and value memory must be released by the owner beforehand
             void deallocate(size_t i) {
-                auto &entry = pool[i];
-                delete[] entry.key;
-                delete[] entry.value;
-                entry.key = nullptr;
-                entry.value = nullptr;
+                auto &entry = get(i);
+                entry.data = nullptr;
+                entry.hash = 0;
+                entry.expiresAt = 0;
                 entry.vSize = 0;
-                entry.compressed = false;
+                entry.kSize = 0;
+                entry.codec = CodecId::None;
+                entry.isInline = false;
+                entry.incompressible = false;
+                entry.respHeaderSize = 0;
+                entry.access = 0;
         
-                entry.nextFree = freeListHead;
+                if (i >= allocationLimit) {
+                    return;
+                }
+                entry.nextFree = static_cast<uint32_t>(freeListHead);
                 freeListHead = i;
             }
 
             Entry& get(size_t i) {
-                return pool[i];
+                return segments[i >> POOL_SEGMENT_BITS][i & SEGMENT_MASK];
+            }
+
+            const Entry& get(size_t i) const {
+                return segments[i >> POOL_SEGMENT_BITS][i & SEGMENT_MASK];
             }
 
+            /// @brief Appends segments until the pool holds at least newSize entries
             void expandPool(size_t newSize) {
-                Entry *newPool = new Entry[newSize];
-                memcpy(newPool, pool, capacity * sizeof(Entry));
-                for (size_t i = capacity; i < newSize - 1; ++i) {
-                    newPool[i].nextFree = i + 1;
+                while (capacity < newSize) {
+                    addSegment();
                 }
-                newPool[newSize - 1].nextFree = 0;
-        
-                delete[] pool;
-                pool = newPool;
-                freeListHead = capacity;  
-                capacity = newSize;
+            }
+
+            size_t getCapacity() const noexcept {
+                return capacity;
+            }
+
+            /// @brief Makes room for segments up front, so the segment table does not move when the pool grows and concurrent readers can keep indexing it
+            void reserveSegments(size_t numSegments) {
+                segments.reserve(numSegments);
+            }
+
+            bool isFree(size_t i) const noexcept {
+                auto &entry = get(i);
+                return !entry.isInline && !entry.data;
+            }
+
+            /// @brief Rebuilds the free list from entries below limit only (lowest index first), entries at and above limit are not handed out anymore
+            void restrictTo(size_t limit) {
+                size_t head = 0;
+                for (size_t i = std::min(limit, capacity); i-- > 1;) {
+                    if (isFree(i)) {
+                        get(i).nextFree = static_cast<uint32_t>(head);
+                        head = i;
+                    }
+                }
+                freeListHead = head;
+                allocationLimit = std::min(limit, capacity);
+            }
+
+            /// @brief Releases whole segments at and above newSize (rounded up to a segment), all of their entries must be free already
+            /// @return false if some of them are still used, in that case the pool keeps its capacity
+            bool shrinkPool(size_t newSize) {
+                auto newSegments = std::max<size_t>((newSize + SEGMENT_MASK) >> POOL_SEGMENT_BITS, 1);
+                if (newSegments >= segments.size()) {
+                    restrictTo(capacity);
+                    return false;
+                }
+                for (size_t i = newSegments * SEGMENT_SIZE; i < capacity; ++i) {
+                    if (!isFree(i)) {
+                        restrictTo(capacity);
+                        return false;
+                    }
+                }
+                segments.resize(newSegments);
+                capacity = newSegments * SEGMENT_SIZE;
+                restrictTo(capacity);
+                return true;
             }
     };
     
@@ -125,13 +370,97 @@ namespace kvs
             uint_fast64_t numCollisions;
             uint_fast32_t numResizes;
 
+            SlabAllocator allocator;
             MemoryPool entryPool;
             bool isResizing = false;
+
+            /// @brief Previous table which is being drained by incremental resize, nullptr when no resize is in progress
+            Bucket *oldTable = nullptr;
+            uint_fast64_t oldTableSize = 0;
+            uint_fast64_t migrationCursor = 0;
+            bool incrementalResize = true;
+            uint_fast32_t migrationBatchSize = 8;
+            uint_fast32_t rehashThreads = 1;
+            /// @brief Deleted slots of the current table, they keep probe sequences intact until the table is rebuilt
+            uint_fast64_t numTombstones = 0;
+
+            /// @brief Keys which found no free slot in their whole probe sequence of the current table.
+            /// Slots of such a sequence never become empty again, so lookups check the stash only after probing all of them
+            std::vector<Bucket> stash;
+            uint_fast64_t numStashed = 0;
+
+            bool shrinkEnabled = true;
+            uint_fast32_t numShrinks = 0;
+            /// @brief Entry pool capacity after the running shrink migration, entries at and above it are moved down while migrating, 0 - not shrinking
+            uint_fast64_t poolShrinkLimit = 0;
+            /// @brief Table sizes the table has grown from, shrinking goes back through them
+            std::vector<uint_fast64_t> smallerSizes;
+            /// @brief Table sizes the table has shrunk from, growing reuses them before taking new sizes
+            std::vector<uint_fast64_t> largerSizes;
+
+            TimingWheel expirations;
+            std::vector<TimerRecord> dueExpirations;
+            uint_fast64_t numExpired = 0;
+
+            uint_fast64_t maxMemory = 0;
+            uint_fast64_t usedMemory = 0;
+            EvictionPolicy evictionPolicy = EvictionPolicy::LRU;
+            uint_fast32_t evictionSamples = 5;
+            uint_fast64_t numEvictions = 0;
+            uint_fast64_t evictedBytes = 0;
+            bool outOfMemory = false;
+            /// @brief Cached monotonic clock used for access tracking, refreshed every ACCESS_CLOCK_REFRESH_OPS accesses
+            uint_fast64_t clockMs = 0;
+            uint_fast64_t numAccesses = 0;
+            uint_fast64_t randomState;
+
             void resize();
+            void rebuildTable(uint_fast64_t newTableSize);
+            void shrink();
+            void shrinkIfSparse();
+            void startMigration(Bucket *newTable, uint_fast64_t newTableSize);
+            uint_fast64_t relocateEntry(uint_fast64_t entryIdx);
+            void migrateBuckets(uint_fast64_t count);
+            void migrateParallel(const Bucket *previousTable, uint_fast64_t previousTableSize);
+            void finishMigration();
+            Bucket* locate(const char *key, size_t kSize, uint_fast64_t hash, int &slot);
+            Bucket* locateLive(const char *key, size_t kSize, uint_fast64_t hash, int &slot);
+            void scheduleExpiration(uint_fast64_t entryIdx);
+            uint_fast64_t nextRandom() noexcept;
+            uint_fast64_t accessClock() noexcept;
+            void touch(Entry &entry) noexcept;
+            uint8_t lfuCounter(uint16_t access, uint_fast64_t nowMs) const noexcept;
+            uint_fast64_t evictionScore(const Entry &entry, uint_fast64_t nowMs) const noexcept;
+            bool reserveMemory(size_t kSize, size_t vSize);
+            bool evictOne();
+            void eraseSlot(Bucket &bucket, int slot);
+            void releaseEntry(uint_fast64_t entryIdx);
+            void freeRecord(char *data, size_t size);
+            void reclaimRecords();
+            void retireTable(Bucket *tableToDelete);
             void copyEntry(Entry &dest, const Entry &src);
-            uint_fast64_t insertEntry(const char *key, const char *value, size_t kSize, size_t vSize);
+            char* allocateRecord(Entry &entry, size_t kSize, size_t vSize, bool framed = false);
+            size_t recordSizeOf(size_t kSize, size_t vSize) const noexcept;
+            uint_fast64_t insertEntry(const char *key, const char *value, size_t kSize, size_t vSize, uint_fast64_t hash, uint_fast64_t expiresAt);
             void migrateEntry(Bucket *newTable, uint_fast64_t newTableSize, uint_fast64_t entryIdx);
-            const char* decompressEntry(const Entry &entry);
+            bool placeEntry(Bucket *tbl, uint_fast64_t size, uint_fast64_t entryIdx);
+            bool claimSlot(Bucket *tbl, uint_fast64_t size, uint_fast64_t entryIdx);
+            bool stashEntry(uint_fast64_t entryIdx);
+            Bucket* findStashed(const char *key, size_t kSize, uint_fast64_t hash, int &slot);
+            void rebuildStash();
+            bool isStashed(const Bucket &bucket) const noexcept {
+                return !stash.empty() && &bucket >= stash.data() && &bucket < stash.data() + stash.size();
+            }
+            /// @param chainFull set to true if no probed bucket has an empty slot, the key may be in the stash then
+            bool findSlot(const Bucket *tbl, uint_fast64_t size, const char *key, size_t kSize, uint_fast64_t hash, uint_fast64_t &bucketIdx, int &slot, bool *chainFull = nullptr) const;
+            ValueView decompressEntry(uint32_t entryIdx);
+            bool compressRecord(Entry &entry, const char *key, size_t kSize, const char *value, size_t vSize);
+            void compressColdEntries();
+            void decompressInPlace(uint32_t entryIdx);
+            uint_fast64_t idleMs(const Entry &entry, uint_fast64_t nowMs) const noexcept;
+            std::optional<ReadResult> tryReadConcurrent(const char *key, size_t kSize, uint_fast64_t hash, std::string &value) const;
+            std::optional<ReadResult> probeConcurrent(const Bucket *tbl, uint_fast64_t size, uint32_t layout, const char *key, size_t kSize, uint_fast64_t hash, std::string &value, bool &chainFull) const;
+            std::optional<ReadResult> matchConcurrent(const Bucket &bucket, uint32_t layout, const char *key, size_t kSize, uint_fast64_t hash, std::string &value, bool &hasEmpty) const;
             void initializeTable(Bucket *table, uint_fast64_t size);
             void cleanTable(Bucket* tableToDelete, uint_fast64_t size);
             uint_fast64_t calcIndex(uint_fast64_t hash, int attempt, uint_fast64_t tableSize) const;
@@ -139,12 +468,65 @@ namespace kvs
             bool usePrimeNumbers = true;
             Primegen primegen;
 
-            struct SubstringFrequency {
-                const char* substring;
-                size_t count;
+            bool compressionEnabled = true;
+            int compressionLevel = GZIP_DEFAULT_LEVEL;
+            CodecId codec = CodecId::Lz4;
+            DictionarySet dictionaries;
+            uint_fast32_t minCompressionSavings = MIN_COMPRESSION_SAVINGS_PERCENT;
+            uint_fast64_t numCompressionSkips = 0;
+            uint_fast64_t numCompressionRejects = 0;
+            uint_fast64_t compressColdAfterMs = 0;
+            /// @brief Entry pool index the next background compression pass starts from
+            uint_fast64_t coldCompressionCursor = 1;
+            uint_fast64_t numColdCompressions = 0;
+            uint_fast64_t numHotDecompressions = 0;
+            ValueCache valueCache;
+            bool respFraming;
+            /// @brief Decompressed value which did not fit into valueCache, kept until the next such value is read
+            std::unique_ptr<char[]> uncachedValue;
+            /// @brief Number of readers sending values straight from record memory
+            uint_fast32_t numPins = 0;
+            struct RetiredRecord {
+                char *data;
+                size_t size;
+                /// @brief Reclamation epoch the record was unlinked in, 0 without concurrent readers
+                uint_fast64_t epoch;
             };
+            /// @brief Records released while pinned or while concurrent readers may use them, freed once the last pin is gone and their epoch is over
+            std::vector<RetiredRecord> retiredRecords;
+            bool concurrentReads;
+            /// @brief Seqlock of concurrent reads, odd while tables, the stash or entries of many buckets are being changed (resize, migration, cold compression)
+            uint32_t layoutVersion = 0;
 
-            bool compressionEnabled = true;
+            static uint32_t loadVersion(const uint32_t &version, std::memory_order order) noexcept {
+                return std::atomic_ref<uint32_t>(const_cast<uint32_t&>(version)).load(order);
+            }
+
+            static void bumpVersion(uint32_t &version, std::memory_order order) noexcept {
+                std::atomic_ref<uint32_t>(version).store(version + 1, order);
+            }
+
+            /// @brief Keeps a version odd while in scope, so concurrent readers retry instead of using what they copied meanwhile.
+            /// Nothing to do without concurrentReads or if the version is already held by an outer scope
+            class VersionWrite : NonCopyableOrMovable {
+                private:
+                    uint32_t *version;
+
+                public:
+                    VersionWrite(const KeyValueStore &store, uint32_t &version, bool active = true) noexcept
+                        : version(store.concurrentReads && active && !(version & 1) ? &version : nullptr) {
+                        if (this->version) {
+                            bumpVersion(version, std::memory_order_relaxed);
+                            std::atomic_thread_fence(std::memory_order_release);
+                        }
+                    }
+
+                    ~VersionWrite() {
+                        if (version) {
+                            bumpVersion(*version, std::memory_order_release);
+                        }
+                    }
+            };
 
         public:
             KeyValueStore(KeyValueStoreSettings settings = KeyValueStoreSettings{});
@@ -154,13 +536,129 @@ namespace kvs
                 return numEntries;
             }
 
+            /// @brief Returns key and value memory usage per size class
+            SlabAllocatorStats getMemoryStats() const noexcept {
+                return allocator.getStats();
+            }
+
+            uint_fast64_t getTableSize() const noexcept {
+                return tableSize;
+            }
+
+            /// @brief Entry pool capacity, shrinks together with the table
+            uint_fast64_t getPoolCapacity() const noexcept {
+                return entryPool.getCapacity();
+            }
+
+            uint_fast32_t getNumShrinks() const noexcept {
+                return numShrinks;
+            }
+
+            /// @brief Number of keys in the overflow stash
+            uint_fast64_t getNumStashed() const noexcept {
+                return numStashed;
+            }
+
+            /// @brief Number of keys removed because their TTL elapsed (both lazily and by removeExpired)
+            uint_fast64_t getNumExpired() const noexcept {
+                return numExpired;
+            }
+
+            /// @brief Memory used by entries, keys and values, this is what maxMemory limits
+            uint_fast64_t getUsedMemory() const noexcept {
+                return usedMemory;
+            }
+
+            uint_fast64_t getNumEvictions() const noexcept {
+                return numEvictions;
+            }
+
+            uint_fast64_t getEvictedBytes() const noexcept {
+                return evictedBytes;
+            }
+
+            /// @brief true if the last set was rejected because of the memory limit
+            bool isOutOfMemory() const noexcept {
+                return outOfMemory;
+            }
+
+            /// @brief Number of compression dictionaries kept, the current one and older ones which values still refer to
+            size_t getNumDictionaries() const noexcept {
+                return dictionaries.size();
+            }
+
+            /// @brief Number of values stored as is because they were estimated to be incompressible
+            uint_fast64_t getNumCompressionSkips() const noexcept {
+                return numCompressionSkips;
+            }
+
+            /// @brief Number of values stored as is because compressing them saved less than minCompressionSavings
+            uint_fast64_t getNumCompressionRejects() const noexcept {
+                return numCompressionRejects;
+            }
+
+            /// @brief Number of values compressed by background compression after they went cold
+            uint_fast64_t getNumColdCompressions() const noexcept {
+                return numColdCompressions;
+            }
+
+            /// @brief Number of cold values decompressed in place because they were read again
+            uint_fast64_t getNumHotDecompressions() const noexcept {
+                return numHotDecompressions;
+            }
+
+            /// @brief Hits, misses and memory usage of the decompressed value cache
+            const ValueCacheStats& getValueCacheStats() const noexcept {
+                return valueCache.getStats();
+            }
+
+            bool isMigrating() const noexcept {
+                return oldTable != nullptr;
+            }
+
+            /// @brief Performs bounded amount of background work (e.g. incremental resize, shrink, dictionary training or compression of cold values), intended to be called on idle event loop ticks and after every batch of requests
+            /// @return true if there is pending work left
+            bool maintenance();
+
+            /// @brief Active expiration, removes keys whose TTL elapsed, examining at most maxRecords scheduled expirations
+            /// @return true if there are more expired keys to remove
+            bool removeExpired(uint_fast32_t maxRecords);
+
             bool set(const char *key, const char *value);
-            bool set(const char *key, const char *value, uint_fast64_t hash);
+            bool set(const char *key, size_t kSize, const char *value, size_t vSize);
+            /// @param ttlMs time to live in milliseconds, 0 - key never expires
+            bool set(const char *key, size_t kSize, const char *value, size_t vSize, uint_fast64_t hash, uint_fast64_t ttlMs = 0);
 
             const char* get(const char *key);
-            const char* get(const char *key, uint_fast64_t hash);
+            ValueView get(const char *key, size_t kSize);
+            ValueView get(const char *key, size_t kSize, uint_fast64_t hash);
+
+            /// @brief Keeps records of pinnable values returned by get() alive until the matching unpin(), even if their keys are overwritten or deleted meanwhile
+            void pin() noexcept {
+                ++numPins;
+            }
+
+            /// @brief Releases a pin, records retired while the store was pinned are freed with the last one
+            void unpin();
+
+            /// @brief Lock-free lookup which may run on any thread while a single other thread calls the rest of the methods, needs concurrentReads.
+            /// Copies the value, so it stays valid whatever the writer does next. Does not refresh access time of the key (for eviction and cold compression)
+            /// and leaves expired keys to the writer. The store must not be destroyed meanwhile
+            ReadResult readConcurrent(const char *key, size_t kSize, uint_fast64_t hash, std::string &value) const;
 
             bool del(const char *key);
-            bool del(const char *key, uint_fast64_t hash);
+            bool del(const char *key, size_t kSize);
+            bool del(const char *key, size_t kSize, uint_fast64_t hash);
+
+            /// @brief Sets TTL of an existing key, non positive ttlMs deletes the key
+            /// @return false if key does not exist
+            bool expire(const char *key, size_t kSize, uint_fast64_t hash, int_fast64_t ttlMs);
+
+            /// @brief Remaining time to live in milliseconds, TTL_NO_EXPIRY or TTL_KEY_NOT_FOUND
+            int_fast64_t ttl(const char *key, size_t kSize, uint_fast64_t hash);
+
+            /// @brief Removes TTL of a key
+            /// @return false if key does not exist or has no TTL
+            bool persist(const char *key, size_t kSize, uint_fast64_t hash);
     };
 }
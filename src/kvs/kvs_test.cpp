@@ -5,6 +5,10 @@
 #include <unistd.h>
 #include <filesystem>
 #include <fstream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
 #include "kvs.hpp"
 #include "../env.hpp"
 
@@ -160,6 +164,1170 @@ TEST(KeyValueStoreTest, DeleteNonexistentKey) {
     ASSERT_FALSE(kvStore.del("missing"));
 }
 
+// Test that deleted slots are reused without leaving stale duplicates behind
+TEST(KeyValueStoreTest, ReinsertAfterDelete) {
+    KeyValueStore kvStore;
+    for (int_fast64_t i = 0; i < 1000; ++i) {
+        auto key = generateKey(i);
+        auto value = generateValue(i);
+        ASSERT_TRUE(kvStore.set(key, value));
+        delete[] key;
+        delete[] value;
+    }
+
+    for (int_fast64_t i = 0; i < 1000; i += 3) {
+        auto key = generateKey(i);
+        ASSERT_TRUE(kvStore.del(key));
+        ASSERT_EQ(kvStore.get(key), nullptr);
+        delete[] key;
+    }
+
+    for (int_fast64_t i = 0; i < 1000; ++i) {
+        auto key = generateKey(i);
+        ASSERT_TRUE(kvStore.set(key, "updated"));
+        delete[] key;
+    }
+    ASSERT_EQ(kvStore.getNumEntries(), 1000);
+
+    for (int_fast64_t i = 0; i < 1000; ++i) {
+        auto key = generateKey(i);
+        ASSERT_STREQ(kvStore.get(key), "updated");
+        ASSERT_TRUE(kvStore.del(key));
+        ASSERT_EQ(kvStore.get(key), nullptr);
+        ASSERT_FALSE(kvStore.del(key));
+        delete[] key;
+    }
+    ASSERT_EQ(kvStore.getNumEntries(), 0);
+}
+
+// Test that keys stay reachable while incremental resize keeps both tables live
+TEST(KeyValueStoreTest, IncrementalResize) {
+    KeyValueStoreSettings settings;
+    settings.migrationBatchSize = 1;
+    KeyValueStore kvStore(settings);
+
+    int_fast64_t i = 0;
+    while (!kvStore.isMigrating()) {
+        auto key = generateKey(i);
+        auto value = generateValue(i);
+        ASSERT_TRUE(kvStore.set(key, value));
+        delete[] key;
+        delete[] value;
+        ++i;
+    }
+    auto numKeys = i;
+
+    for (i = 0; i < numKeys; ++i) {
+        auto key = generateKey(i);
+        auto value = generateValue(i);
+        if (i % 2 == 0) {
+            ASSERT_TRUE(kvStore.del(key));
+        } else {
+            ASSERT_STREQ(kvStore.get(key), value);
+        }
+        delete[] key;
+        delete[] value;
+    }
+
+    while (kvStore.maintenance());
+    ASSERT_FALSE(kvStore.isMigrating());
+    ASSERT_EQ(kvStore.getNumEntries(), numKeys / 2);
+
+    for (i = 0; i < numKeys; ++i) {
+        auto key = generateKey(i);
+        auto value = generateValue(i);
+        if (i % 2 == 0) {
+            ASSERT_EQ(kvStore.get(key), nullptr);
+        } else {
+            ASSERT_STREQ(kvStore.get(key), value);
+        }
+        delete[] key;
+        delete[] value;
+    }
+}
+
+// Test stop-the-world resize mode
+TEST(KeyValueStoreTest, BlockingResize) {
+    KeyValueStoreSettings settings;
+    settings.incrementalResize = false;
+    KeyValueStore kvStore(settings);
+    for (int_fast64_t i = 0; i < 100000; ++i) {
+        auto key = generateKey(i);
+        auto value = generateValue(i);
+        ASSERT_TRUE(kvStore.set(key, value));
+        ASSERT_FALSE(kvStore.isMigrating());
+        delete[] key;
+        delete[] value;
+    }
+
+    for (int_fast64_t i = 0; i < 100000; ++i) {
+        auto key = generateKey(i);
+        auto value = generateValue(i);
+        ASSERT_STREQ(kvStore.get(key), value);
+        delete[] key;
+        delete[] value;
+    }
+}
+
+// Test that blocking resize of big tables split between rehash threads keeps every key, including the ones whose probe sequence overflows
+TEST(KeyValueStoreTest, ParallelBlockingResize) {
+    KeyValueStoreSettings settings;
+    settings.incrementalResize = false;
+    settings.rehashThreads = 4;
+    KeyValueStore kvStore(settings);
+    const uint_fast64_t hash = 42;
+    const int numColliding = MAX_READ_WRITE_ATTEMPTS * BUCKET_SIZE + 5;
+    auto colliding = [](int i) { return "colliding" + std::to_string(i); };
+    for (int i = 0; i < numColliding; ++i) {
+        ASSERT_TRUE(kvStore.set(colliding(i).data(), colliding(i).size(), "value", 5, hash));
+    }
+    for (int_fast64_t i = 0; i < 400000; ++i) {
+        auto key = "key" + std::to_string(i);
+        ASSERT_TRUE(kvStore.set(key.data(), key.size(), key.data(), key.size()));
+    }
+    ASSERT_GT(kvStore.getTableSize(), PARALLEL_REHASH_MIN_BUCKETS);
+    ASSERT_EQ(kvStore.getNumEntries(), 400000 + numColliding);
+    ASSERT_GE(kvStore.getNumStashed(), 5);
+    for (int_fast64_t i = 0; i < 400000; ++i) {
+        auto key = "key" + std::to_string(i);
+        auto stored = kvStore.get(key.data(), key.size());
+        ASSERT_EQ(std::string(stored.data, stored.size), key);
+    }
+    for (int i = 0; i < numColliding; ++i) {
+        ASSERT_STREQ(kvStore.get(colliding(i).data(), colliding(i).size(), hash).data, "value");
+    }
+}
+
+// Test that table and entry pool shrink after mass deletion and keep the remaining keys (with their TTLs) reachable
+TEST(KeyValueStoreTest, ShrinkAfterMassDelete) {
+    for (bool incremental : {true, false}) {
+        KeyValueStoreSettings settings;
+        settings.incrementalResize = incremental;
+        KeyValueStore kvStore(settings);
+        const int_fast64_t numKeys = 100000;
+        for (int_fast64_t i = 0; i < numKeys; ++i) {
+            auto key = generateKey(i);
+            auto value = generateValue(i);
+            ASSERT_TRUE(kvStore.set(key, strlen(key), value, strlen(value), hashFunc(key), i % 100 == 0 ? 3600000 : 0));
+            delete[] key;
+            delete[] value;
+        }
+        while (kvStore.maintenance());
+        auto grownTableSize = kvStore.getTableSize();
+        auto grownPoolCapacity = kvStore.getPoolCapacity();
+
+        for (int_fast64_t i = 0; i < numKeys; ++i) {
+            if (i % 50 == 0) {
+                continue;
+            }
+            auto key = generateKey(i);
+            ASSERT_TRUE(kvStore.del(key));
+            delete[] key;
+        }
+        while (kvStore.maintenance());
+
+        ASSERT_GT(kvStore.getNumShrinks(), 0u);
+        ASSERT_LT(kvStore.getTableSize(), grownTableSize);
+        ASSERT_LT(kvStore.getPoolCapacity(), grownPoolCapacity);
+        ASSERT_EQ(kvStore.getNumEntries(), static_cast<uint_fast64_t>(numKeys / 50));
+        for (int_fast64_t i = 0; i < numKeys; i += 50) {
+            auto key = generateKey(i);
+            auto value = generateValue(i);
+            ASSERT_STREQ(kvStore.get(key), value);
+            auto ttl = kvStore.ttl(key, strlen(key), hashFunc(key));
+            if (i % 100 == 0) {
+                ASSERT_GT(ttl, 0);
+            } else {
+                ASSERT_EQ(ttl, TTL_NO_EXPIRY);
+            }
+            delete[] key;
+            delete[] value;
+        }
+
+        // Table grows back through the same sizes
+        for (int_fast64_t i = 0; i < numKeys; ++i) {
+            auto key = generateKey(i);
+            auto value = generateValue(i);
+            ASSERT_TRUE(kvStore.set(key, value));
+            delete[] key;
+            delete[] value;
+        }
+        while (kvStore.maintenance());
+        ASSERT_EQ(kvStore.getNumEntries(), static_cast<uint_fast64_t>(numKeys));
+        for (int_fast64_t i = 0; i < numKeys; ++i) {
+            auto key = generateKey(i);
+            auto value = generateValue(i);
+            ASSERT_STREQ(kvStore.get(key), value);
+            delete[] key;
+            delete[] value;
+        }
+    }
+}
+
+// Test that the table grows only at high load and no insert fails on the way
+TEST(KeyValueStoreTest, HighLoadFactor) {
+    KeyValueStore kvStore;
+    double maxLoad = 0;
+    auto tableSize = kvStore.getTableSize();
+    for (int_fast64_t i = 0; i < 300000; ++i) {
+        auto key = "key" + std::to_string(i);
+        ASSERT_TRUE(kvStore.set(key.data(), key.size(), "value", 5));
+        if (kvStore.getTableSize() != tableSize) {
+            tableSize = kvStore.getTableSize();
+        } else {
+            maxLoad = std::max(maxLoad, static_cast<double>(kvStore.getNumEntries()) / (tableSize * BUCKET_SIZE));
+        }
+    }
+    ASSERT_GT(maxLoad, 0.85);
+    for (int_fast64_t i = 0; i < 300000; ++i) {
+        auto key = "key" + std::to_string(i);
+        ASSERT_TRUE(kvStore.get(key.data(), key.size()));
+    }
+}
+
+// Test that keys whose whole probe sequence is full go to the overflow stash and stay reachable through deletes and resizes
+TEST(KeyValueStoreTest, OverflowStash) {
+    KeyValueStore kvStore;
+    const uint_fast64_t hash = 42;
+    const int chainSlots = MAX_READ_WRITE_ATTEMPTS * BUCKET_SIZE;
+    auto key = [](int i) { return "colliding" + std::to_string(i); };
+    for (int i = 0; i < chainSlots + 10; ++i) {
+        ASSERT_TRUE(kvStore.set(key(i).data(), key(i).size(), key(i).data(), key(i).size(), hash));
+    }
+    ASSERT_EQ(kvStore.getNumStashed(), 10);
+    for (int i = 0; i < chainSlots + 10; ++i) {
+        auto stored = kvStore.get(key(i).data(), key(i).size(), hash);
+        ASSERT_EQ(std::string(stored.data, stored.size), key(i));
+    }
+    ASSERT_FALSE(kvStore.get("missing", 7, hash));
+
+    // Stashed key is overwritten in place, freed table slots are reused by new keys only
+    ASSERT_TRUE(kvStore.set(key(chainSlots).data(), key(chainSlots).size(), "new", 3, hash));
+    ASSERT_STREQ(kvStore.get(key(chainSlots).data(), key(chainSlots).size(), hash).data, "new");
+    ASSERT_TRUE(kvStore.del(key(0).data(), key(0).size(), hash));
+    ASSERT_STREQ(kvStore.get(key(chainSlots + 1).data(), key(chainSlots + 1).size(), hash).data, key(chainSlots + 1).c_str());
+    ASSERT_TRUE(kvStore.set(key(0).data(), key(0).size(), "again", 5, hash));
+    ASSERT_EQ(kvStore.getNumStashed(), 10);
+    ASSERT_TRUE(kvStore.del(key(chainSlots + 2).data(), key(chainSlots + 2).size(), hash));
+    ASSERT_FALSE(kvStore.get(key(chainSlots + 2).data(), key(chainSlots + 2).size(), hash));
+    ASSERT_EQ(kvStore.getNumStashed(), 9);
+
+    auto tableSize = kvStore.getTableSize();
+    for (int_fast64_t i = 0; i < 50000; ++i) {
+        auto other = "key" + std::to_string(i);
+        ASSERT_TRUE(kvStore.set(other.data(), other.size(), "value", 5));
+    }
+    while (kvStore.maintenance());
+    ASSERT_GT(kvStore.getTableSize(), tableSize);
+    for (int i = 0; i < chainSlots + 10; ++i) {
+        ASSERT_EQ(static_cast<bool>(kvStore.get(key(i).data(), key(i).size(), hash)), i != chainSlots + 2);
+    }
+    // Other keys may share the full probe sequence of the colliding ones
+    ASSERT_GE(kvStore.getNumStashed(), 9);
+
+    // Growing a sparse table would not help keys with equal hashes, once the stash is full their inserts fail
+    int numColliding = chainSlots + 10;
+    while (kvStore.set(key(numColliding).data(), key(numColliding).size(), "v", 1, hash)) {
+        ++numColliding;
+    }
+    ASSERT_GT(kvStore.getNumStashed(), 9);
+    ASSERT_EQ(kvStore.getNumStashed() % BUCKET_SIZE, 0);
+    ASSERT_FALSE(kvStore.get(key(numColliding).data(), key(numColliding).size(), hash));
+    ASSERT_TRUE(kvStore.get(key(numColliding - 1).data(), key(numColliding - 1).size(), hash));
+}
+
+// Test power of two table sizes and that shard selection does not narrow the buckets used within a shard
+TEST(KeyValueStoreTest, PowerOfTwoTableSizes) {
+    KeyValueStoreSettings settings;
+    settings.usePrimeNumbers = false;
+    KeyValueStore kvStore(settings);
+    ASSERT_TRUE(std::has_single_bit(kvStore.getTableSize()));
+
+    const int_fast64_t numKeys = 100000;
+    const uint_fast32_t numShards = 24;
+    std::vector<uint_fast64_t> shardKeys(numShards);
+    std::vector<bool> shardZeroBuckets(64);
+    for (int_fast64_t i = 0; i < numKeys; ++i) {
+        auto key = generateKey(i);
+        auto value = generateValue(i);
+        ASSERT_TRUE(kvStore.set(key, value));
+        auto hash = hashFunc(key);
+        auto shard = shardIndex(hash, numShards);
+        ASSERT_LT(shard, numShards);
+        ++shardKeys[shard];
+        if (shard == 0) {
+            shardZeroBuckets[hash & 63] = true;
+        }
+        delete[] key;
+        delete[] value;
+    }
+    ASSERT_TRUE(std::has_single_bit(kvStore.getTableSize()));
+    for (auto count : shardKeys) {
+        ASSERT_GT(count, numKeys / numShards * 8 / 10);
+    }
+    ASSERT_EQ(std::count(shardZeroBuckets.begin(), shardZeroBuckets.end(), true), 64);
+
+    for (int_fast64_t i = 0; i < numKeys; ++i) {
+        auto key = generateKey(i);
+        auto value = generateValue(i);
+        ASSERT_STREQ(kvStore.get(key), value);
+        delete[] key;
+        delete[] value;
+    }
+}
+
+// Test values stored with every codec, each store keeps its own codec per entry
+TEST(KeyValueStoreTest, ValueCodecs) {
+    for (auto codec : {CodecId::Gzip, CodecId::Lz4}) {
+        KeyValueStoreSettings settings;
+        settings.codec = codec;
+        KeyValueStore kvStore(settings);
+        for (int i = 0; i < 1000; ++i) {
+            std::string value;
+            for (int j = 0; j < i % 20 + 1; ++j) {
+                value += "{\"field\":\"value" + std::to_string(j) + "\"},";
+            }
+            value.push_back('\0');
+            value += std::to_string(i);
+            auto key = "key" + std::to_string(i);
+            ASSERT_TRUE(kvStore.set(key.data(), key.size(), value.data(), value.size()));
+            auto stored = kvStore.get(key.data(), key.size());
+            ASSERT_TRUE(stored) << ValueCodec::Name(codec);
+            ASSERT_EQ(std::string(stored.data, stored.size), value) << ValueCodec::Name(codec);
+        }
+    }
+}
+
+// Test that small values are compressed with the trained dictionary once maintenance steps train it, and old values stay readable
+TEST(KeyValueStoreTest, DictionaryCompression) {
+    auto makeValue = [](int i) {
+        return "{\"base\":\"EUR\",\"date\":\"2024-01-" + std::to_string(i % 28 + 1) + "\",\"rates\":{\"USD\":1." + std::to_string(i % 97)
+            + ",\"GBP\":0." + std::to_string(i % 89) + ",\"JPY\":" + std::to_string(150 + i % 13) + "},\"id\":" + std::to_string(i) + "}";
+    };
+    KeyValueStoreSettings plainSettings;
+    plainSettings.codec = CodecId::Gzip;
+    KeyValueStoreSettings dictionarySettings = plainSettings;
+    dictionarySettings.dictionarySize = 2048;
+    KeyValueStore plainStore(plainSettings);
+    KeyValueStore kvStore(dictionarySettings);
+
+    for (int i = 0; i < 2000; ++i) {
+        auto key = "key" + std::to_string(i), value = makeValue(i);
+        ASSERT_TRUE(kvStore.set(key.data(), key.size(), value.data(), value.size()));
+    }
+    ASSERT_EQ(kvStore.getNumDictionaries(), 0);
+    // Training takes several bounded maintenance steps
+    ASSERT_TRUE(kvStore.maintenance());
+    ASSERT_EQ(kvStore.getNumDictionaries(), 0);
+    while (kvStore.maintenance());
+    ASSERT_EQ(kvStore.getNumDictionaries(), 1);
+
+    for (int i = 0; i < 4000; ++i) {
+        auto key = "key" + std::to_string(i), value = makeValue(i);
+        ASSERT_TRUE(kvStore.set(key.data(), key.size(), value.data(), value.size()));
+        ASSERT_TRUE(plainStore.set(key.data(), key.size(), value.data(), value.size()));
+    }
+    for (int i = 0; i < 4000; ++i) {
+        auto key = "key" + std::to_string(i), value = makeValue(i);
+        auto stored = kvStore.get(key.data(), key.size());
+        ASSERT_TRUE(stored);
+        ASSERT_EQ(std::string(stored.data, stored.size), value);
+    }
+    ASSERT_LT(kvStore.getUsedMemory(), plainStore.getUsedMemory());
+
+    for (int i = 0; i < 4000; ++i) {
+        auto key = "key" + std::to_string(i);
+        ASSERT_TRUE(kvStore.del(key.data(), key.size()));
+    }
+    ASSERT_EQ(kvStore.getNumDictionaries(), 1);
+}
+
+// Test that incompressible values are stored as is, either without a compression attempt or after one which saved too little
+TEST(KeyValueStoreTest, IncompressibleValues) {
+    std::mt19937 rng(11);
+    for (auto codec : {CodecId::Gzip, CodecId::Lz4}) {
+        KeyValueStoreSettings settings;
+        settings.codec = codec;
+        settings.minCompressionSavings = 20;
+        KeyValueStore kvStore(settings);
+        uint_fast64_t rawBytes = 0;
+        for (int i = 0; i < 200; ++i) {
+            std::string value(32 + i * 10, '\0');
+            for (auto &c : value) {
+                c = static_cast<char>(rng());
+            }
+            auto key = "random" + std::to_string(i);
+            ASSERT_TRUE(kvStore.set(key.data(), key.size(), value.data(), value.size()));
+            auto stored = kvStore.get(key.data(), key.size());
+            ASSERT_EQ(std::string(stored.data, stored.size), value);
+            rawBytes += sizeof(Entry) + key.size() + value.size() + 1;
+        }
+        ASSERT_EQ(kvStore.getNumCompressionSkips() + kvStore.getNumCompressionRejects(), 200) << ValueCodec::Name(codec);
+        ASSERT_GT(kvStore.getNumCompressionSkips(), 150) << ValueCodec::Name(codec);
+        ASSERT_EQ(kvStore.getUsedMemory(), rawBytes) << ValueCodec::Name(codec);
+
+        std::string json;
+        for (int i = 0; i < 20; ++i) {
+            json += "{\"field\":\"value" + std::to_string(i) + "\"},";
+        }
+        ASSERT_TRUE(kvStore.set("json", 4, json.data(), json.size()));
+        ASSERT_EQ(kvStore.getNumCompressionSkips() + kvStore.getNumCompressionRejects(), 200) << ValueCodec::Name(codec);
+        ASSERT_LT(kvStore.getUsedMemory(), rawBytes + sizeof(Entry) + json.size()) << ValueCodec::Name(codec);
+    }
+}
+
+// Test that values are written uncompressed, compressed by maintenance once cold and decompressed in place when read again
+TEST(KeyValueStoreTest, ColdValueCompression) {
+    KeyValueStoreSettings settings;
+    settings.compressColdAfterMs = 1000;
+    KeyValueStore kvStore(settings);
+    std::vector<std::string> values;
+    for (int i = 0; i < 1000; ++i) {
+        std::string value;
+        for (int j = 0; j < i % 10 + 3; ++j) {
+            value += "{\"field\":\"value" + std::to_string(j) + "\"},";
+        }
+        values.push_back(value + std::to_string(i));
+        auto key = "key" + std::to_string(i);
+        ASSERT_TRUE(kvStore.set(key.data(), key.size(), values[i].data(), values[i].size()));
+    }
+    auto rawMemory = kvStore.getUsedMemory();
+    kvStore.maintenance();
+    ASSERT_EQ(kvStore.getNumColdCompressions(), 0);
+
+    usleep(2100000);
+    for (int i = 0; i < 1000; ++i) {
+        kvStore.maintenance();
+    }
+    ASSERT_EQ(kvStore.getNumColdCompressions(), 1000);
+    auto coldMemory = kvStore.getUsedMemory();
+    ASSERT_LT(coldMemory, rawMemory);
+
+    for (int i = 0; i < 1000; i += 2) {
+        auto key = "key" + std::to_string(i);
+        auto stored = kvStore.get(key.data(), key.size());
+        ASSERT_TRUE(stored);
+        ASSERT_EQ(std::string(stored.data, stored.size), values[i]);
+    }
+    ASSERT_EQ(kvStore.getNumHotDecompressions(), 500);
+    ASSERT_GT(kvStore.getUsedMemory(), coldMemory);
+
+    // Hot values are not compressed again right away
+    for (int i = 0; i < 1000; ++i) {
+        kvStore.maintenance();
+    }
+    ASSERT_EQ(kvStore.getNumColdCompressions(), 1000);
+    for (int i = 0; i < 1000; ++i) {
+        auto key = "key" + std::to_string(i);
+        auto stored = kvStore.get(key.data(), key.size());
+        ASSERT_EQ(std::string(stored.data, stored.size), values[i]);
+        ASSERT_TRUE(kvStore.del(key.data(), key.size()));
+    }
+    ASSERT_EQ(kvStore.getUsedMemory(), 0);
+}
+
+// Test that cold values get compressed while hot keys keep being read and written, with one maintenance step per batch of requests like a busy server
+TEST(KeyValueStoreTest, ColdValueCompressionUnderLoad) {
+    KeyValueStoreSettings settings;
+    settings.compressColdAfterMs = 2000;
+    KeyValueStore kvStore(settings);
+    auto makeValue = [](int i) {
+        std::string value;
+        for (int j = 0; j < i % 10 + 3; ++j) {
+            value += "{\"field\":\"value" + std::to_string(j) + "\"},";
+        }
+        return value + std::to_string(i);
+    };
+    for (int i = 0; i < 1000; ++i) {
+        auto key = "cold" + std::to_string(i), value = makeValue(i);
+        ASSERT_TRUE(kvStore.set(key.data(), key.size(), value.data(), value.size()));
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(3500);
+    uint_fast64_t batches = 0;
+    while (std::chrono::steady_clock::now() < deadline) {
+        for (int i = 0; i < 100; ++i) {
+            auto key = "hot" + std::to_string(i), value = makeValue(i);
+            if (batches % 2) {
+                auto stored = kvStore.get(key.data(), key.size());
+                ASSERT_TRUE(stored);
+                ASSERT_EQ(std::string(stored.data, stored.size), value);
+            } else {
+                ASSERT_TRUE(kvStore.set(key.data(), key.size(), value.data(), value.size()));
+            }
+        }
+        kvStore.maintenance();
+        ++batches;
+        usleep(100);
+    }
+    ASSERT_EQ(kvStore.getNumColdCompressions(), 1000);
+    for (int i = 0; i < 1000; ++i) {
+        auto key = "cold" + std::to_string(i);
+        auto stored = kvStore.get(key.data(), key.size());
+        ASSERT_TRUE(stored);
+        ASSERT_EQ(std::string(stored.data, stored.size), makeValue(i));
+    }
+}
+
+// Test that repeated reads of compressed values are served from the cache and modified values are never served stale
+TEST(KeyValueStoreTest, DecompressedValueCache) {
+    KeyValueStoreSettings settings;
+    settings.valueCacheSize = 16 * 1024;
+    KeyValueStore kvStore(settings);
+    auto makeValue = [](int i, int version) {
+        std::string value;
+        for (int j = 0; j < 20; ++j) {
+            value += "{\"field\":\"value" + std::to_string(j) + "\"},";
+        }
+        return value + std::to_string(i) + "v" + std::to_string(version);
+    };
+    for (int i = 0; i < 100; ++i) {
+        auto key = "key" + std::to_string(i), value = makeValue(i, 0);
+        ASSERT_TRUE(kvStore.set(key.data(), key.size(), value.data(), value.size()));
+    }
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 10; ++i) {
+            auto key = "key" + std::to_string(i);
+            auto stored = kvStore.get(key.data(), key.size());
+            ASSERT_EQ(std::string(stored.data, stored.size), makeValue(i, 0));
+        }
+    }
+    ASSERT_EQ(kvStore.getValueCacheStats().misses, 10);
+    ASSERT_EQ(kvStore.getValueCacheStats().hits, 20);
+    ASSERT_EQ(kvStore.getValueCacheStats().numValues, 10);
+
+    for (int i = 0; i < 10; ++i) {
+        auto key = "key" + std::to_string(i), value = makeValue(i, 1);
+        ASSERT_TRUE(kvStore.set(key.data(), key.size(), value.data(), value.size()));
+        auto stored = kvStore.get(key.data(), key.size());
+        ASSERT_EQ(std::string(stored.data, stored.size), value);
+    }
+    ASSERT_EQ(kvStore.getValueCacheStats().hits, 20);
+
+    // Reading all values keeps the cache within its capacity
+    for (int i = 0; i < 100; ++i) {
+        auto key = "key" + std::to_string(i);
+        ASSERT_TRUE(kvStore.get(key.data(), key.size()));
+    }
+    ASSERT_LE(kvStore.getValueCacheStats().usedBytes, settings.valueCacheSize);
+    for (int i = 0; i < 100; ++i) {
+        auto key = "key" + std::to_string(i);
+        ASSERT_TRUE(kvStore.del(key.data(), key.size()));
+    }
+    ASSERT_EQ(kvStore.getValueCacheStats().usedBytes, 0);
+
+    // Values larger than the whole cache are still returned
+    std::string large(64 * 1024, 'x');
+    ASSERT_TRUE(kvStore.set("large", 5, large.data(), large.size()));
+    auto stored = kvStore.get("large", 5);
+    ASSERT_EQ(std::string(stored.data, stored.size), large);
+    ASSERT_EQ(kvStore.getValueCacheStats().numValues, 0);
+}
+
+// Test that pinned values stay readable after their keys are overwritten or deleted and are freed with the last pin
+TEST(KeyValueStoreTest, PinnedValues) {
+    KeyValueStoreSettings settings;
+    settings.compressionEnabled = false;
+    KeyValueStore kvStore(settings);
+    std::string first(4096, 'a'), second(4096, 'b');
+    ASSERT_TRUE(kvStore.set("first", 5, first.data(), first.size()));
+    ASSERT_TRUE(kvStore.set("second", 6, second.data(), second.size()));
+    ASSERT_TRUE(kvStore.set("small", 5, "v", 1));
+    ASSERT_FALSE(kvStore.get("small", 5).pinnable);
+
+    auto requestedBytes = kvStore.getMemoryStats().requestedBytes();
+    kvStore.pin();
+    auto firstView = kvStore.get("first", 5);
+    ASSERT_TRUE(firstView.pinnable);
+    kvStore.pin();
+    auto secondView = kvStore.get("second", 6);
+    ASSERT_TRUE(secondView.pinnable);
+
+    std::string replacement(4096, 'c');
+    ASSERT_TRUE(kvStore.set("first", 5, replacement.data(), replacement.size()));
+    ASSERT_TRUE(kvStore.del("second", 6));
+    ASSERT_EQ(std::string(firstView.data, firstView.size), first);
+    ASSERT_EQ(std::string(secondView.data, secondView.size), second);
+    auto stored = kvStore.get("first", 5);
+    ASSERT_EQ(std::string(stored.data, stored.size), replacement);
+
+    kvStore.unpin();
+    ASSERT_EQ(std::string(secondView.data, secondView.size), second);
+    ASSERT_GT(kvStore.getMemoryStats().requestedBytes(), requestedBytes);
+    kvStore.unpin();
+    ASSERT_LT(kvStore.getMemoryStats().requestedBytes(), requestedBytes);
+}
+
+// Test lock-free reads of plain, compressed, missing, expired, stashed and not yet migrated keys, and stores without concurrentReads
+TEST(KeyValueStoreTest, ConcurrentReads) {
+    KeyValueStoreSettings settings;
+    settings.concurrentReads = true;
+    KeyValueStore kvStore(settings);
+    std::string compressible(2048, 'z');
+    ASSERT_TRUE(kvStore.set("plain", 5, "value", 5));
+    ASSERT_TRUE(kvStore.set("compressed", 10, compressible.data(), compressible.size()));
+    ASSERT_TRUE(kvStore.set("expiring", 8, "value", 5, hashFunc("expiring", 8), 1));
+
+    std::string value;
+    ASSERT_EQ(kvStore.readConcurrent("plain", 5, hashFunc("plain", 5), value), ReadResult::Found);
+    ASSERT_EQ(value, "value");
+    ASSERT_EQ(kvStore.readConcurrent("compressed", 10, hashFunc("compressed", 10), value), ReadResult::Found);
+    ASSERT_EQ(value, compressible);
+    ASSERT_EQ(kvStore.readConcurrent("missing", 7, hashFunc("missing", 7), value), ReadResult::NotFound);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ASSERT_EQ(kvStore.readConcurrent("expiring", 8, hashFunc("expiring", 8), value), ReadResult::NotFound);
+
+    // Keys in the overflow stash and keys still in the old table during incremental resize
+    const uint_fast64_t hash = 42;
+    for (int i = 0; i < MAX_READ_WRITE_ATTEMPTS * BUCKET_SIZE + 3; ++i) {
+        auto key = "colliding" + std::to_string(i);
+        ASSERT_TRUE(kvStore.set(key.data(), key.size(), key.data(), key.size(), hash));
+    }
+    ASSERT_EQ(kvStore.getNumStashed(), 3);
+    for (int_fast64_t i = 0; !kvStore.isMigrating(); ++i) {
+        auto key = "key" + std::to_string(i);
+        ASSERT_TRUE(kvStore.set(key.data(), key.size(), key.data(), key.size()));
+    }
+    for (int i = 0; i < MAX_READ_WRITE_ATTEMPTS * BUCKET_SIZE + 3; ++i) {
+        auto key = "colliding" + std::to_string(i);
+        ASSERT_EQ(kvStore.readConcurrent(key.data(), key.size(), hash, value), ReadResult::Found);
+        ASSERT_EQ(value, key);
+    }
+    ASSERT_EQ(kvStore.readConcurrent("key0", 4, hashFunc("key0", 4), value), ReadResult::Found);
+    ASSERT_EQ(value, "key0");
+
+    KeyValueStore plainStore;
+    ASSERT_TRUE(plainStore.set("plain", 5, "value", 5));
+    ASSERT_EQ(plainStore.readConcurrent("plain", 5, hashFunc("plain", 5), value), ReadResult::Conflict);
+}
+
+// Test readers on other threads never see a torn, foreign or freed value while the writer overwrites, deletes, resizes, shrinks and compresses
+TEST(KeyValueStoreTest, ConcurrentReadsDuringWrites) {
+    KeyValueStoreSettings settings;
+    settings.initialSize = 17;
+    settings.concurrentReads = true;
+    KeyValueStore kvStore(settings);
+    const int numStable = 1000, numKeys = 60000;
+    auto makeKey = [](int i) { return "key" + std::to_string(i); };
+    // Long runs of the same byte compress, so some of the values are stored compressed
+    auto makeValue = [&makeKey](int i, int generation) {
+        return makeKey(i) + ":" + std::to_string(generation) + ":" + std::string((i * 7 + generation) % 300, 'x');
+    };
+    auto isValid = [&makeKey](int i, const std::string &value) {
+        auto prefix = makeKey(i) + ":";
+        if (value.compare(0, prefix.size(), prefix) != 0) {
+            return false;
+        }
+        char *end;
+        auto generation = strtoul(value.c_str() + prefix.size(), &end, 10);
+        auto padding = (i * 7 + generation) % 300;
+        return *end == ':' && value.size() == static_cast<size_t>(end - value.c_str()) + 1 + padding
+            && value.find_first_not_of('x', end - value.c_str() + 1) == std::string::npos;
+    };
+    for (int i = 0; i < numStable; ++i) {
+        auto key = makeKey(i), value = makeValue(i, 0);
+        ASSERT_TRUE(kvStore.set(key.data(), key.size(), value.data(), value.size()));
+    }
+
+    std::atomic<bool> stop = false;
+    std::atomic<uint_fast64_t> numInvalid = 0, numStableMissing = 0, numFound = 0;
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&, r] {
+            std::mt19937 rng(r);
+            std::string value;
+            while (!stop.load(std::memory_order_relaxed)) {
+                int i = rng() % 2 ? static_cast<int>(rng() % numStable) : static_cast<int>(rng() % numKeys);
+                auto key = makeKey(i);
+                auto result = kvStore.readConcurrent(key.data(), key.size(), hashFunc(key.data(), key.size()), value);
+                if (result == ReadResult::Found) {
+                    ++numFound;
+                    numInvalid += !isValid(i, value);
+                } else if (result == ReadResult::NotFound && i < numStable) {
+                    ++numStableMissing;
+                }
+            }
+        });
+    }
+
+    // Grow through incremental resizes, overwrite everything, then delete most keys so the table shrinks
+    for (int generation = 1; generation <= 3; ++generation) {
+        for (int i = 0; i < numKeys; ++i) {
+            auto key = makeKey(i), value = makeValue(i, generation);
+            ASSERT_TRUE(kvStore.set(key.data(), key.size(), value.data(), value.size()));
+        }
+        for (int i = numStable; i < numKeys; ++i) {
+            auto key = makeKey(i);
+            ASSERT_TRUE(kvStore.del(key.data(), key.size()));
+            if (i % 1000 == 0) {
+                kvStore.maintenance();
+            }
+        }
+        while (kvStore.maintenance());
+    }
+    stop = true;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    ASSERT_GT(kvStore.getNumShrinks(), 0);
+    ASSERT_GT(numFound.load(), 0);
+    ASSERT_EQ(numInvalid.load(), 0);
+    ASSERT_EQ(numStableMissing.load(), 0);
+    std::string value;
+    for (int i = 0; i < numStable; ++i) {
+        auto key = makeKey(i);
+        ASSERT_EQ(kvStore.readConcurrent(key.data(), key.size(), hashFunc(key.data(), key.size()), value), ReadResult::Found);
+        ASSERT_EQ(value, makeValue(i, 3));
+    }
+}
+
+// Test that values are stored with RESP bulk string framing through overwrites and resizes, and compressed values are not framed
+TEST(KeyValueStoreTest, RespFraming) {
+    KeyValueStoreSettings settings;
+    settings.initialSize = 17;
+    settings.respFraming = true;
+    KeyValueStore kvStore(settings);
+    auto makeValue = [](int i) {
+        // Random bytes do not compress, so every value is stored as is
+        std::mt19937 rng(i);
+        std::string value(i % 3 == 0 ? 1 + i % 9 : 10 + i * 7, '\0');
+        for (auto& c : value) {
+            c = static_cast<char>(rng());
+        }
+        return value;
+    };
+    for (int i = 0; i < 500; ++i) {
+        auto key = "key" + std::to_string(i), value = makeValue(i);
+        ASSERT_TRUE(kvStore.set(key.data(), key.size(), value.data(), value.size()));
+    }
+    ASSERT_GT(kvStore.getTableSize(), 17);
+    for (int i = 0; i < 500; ++i) {
+        auto key = "key" + std::to_string(i), value = makeValue(i);
+        auto stored = kvStore.get(key.data(), key.size());
+        ASSERT_EQ(std::string(stored.data, stored.size), value);
+        ASSERT_EQ(stored.respFrame(), "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n");
+    }
+
+    std::string compressible(4096, 'x');
+    ASSERT_TRUE(kvStore.set("key1", 4, compressible.data(), compressible.size()));
+    auto stored = kvStore.get("key1", 4);
+    ASSERT_EQ(std::string(stored.data, stored.size), compressible);
+    ASSERT_TRUE(stored.respFrame().empty());
+
+    for (int i = 0; i < 500; ++i) {
+        auto key = "key" + std::to_string(i);
+        ASSERT_TRUE(kvStore.del(key.data(), key.size()));
+    }
+    ASSERT_EQ(kvStore.getUsedMemory(), 0);
+}
+
+TEST(ValueCacheTest, LruEviction) {
+    ValueCache cache(3 * 11);
+    auto makeValue = [](char c) {
+        auto data = new char[11];
+        memset(data, c, 10);
+        data[10] = '\0';
+        return data;
+    };
+    ASSERT_EQ(cache.insert(1, makeValue('a'), 10), "aaaaaaaaaa");
+    cache.insert(2, makeValue('b'), 10);
+    cache.insert(3, makeValue('c'), 10);
+    ASSERT_EQ(cache.find(1), "aaaaaaaaaa");
+    cache.insert(4, makeValue('d'), 10);
+    ASSERT_EQ(cache.find(2).data(), nullptr);
+    ASSERT_EQ(cache.find(3), "cccccccccc");
+    ASSERT_EQ(cache.getStats().usedBytes, 33);
+
+    cache.erase(3);
+    ASSERT_EQ(cache.find(3).data(), nullptr);
+    ASSERT_EQ(cache.getStats().numValues, 2);
+
+    auto tooLarge = new char[40];
+    ASSERT_EQ(cache.insert(5, tooLarge, 39).data(), nullptr);
+    delete[] tooLarge;
+    ASSERT_EQ(cache.getStats().hits, 2);
+    ASSERT_EQ(cache.getStats().misses, 2);
+}
+
+// Test records which fit into the entry inline storage and records which need a separate allocation
+TEST(KeyValueStoreTest, MixedRecordSizes) {
+    for (auto compressionEnabled : {false, true}) {
+        KeyValueStoreSettings settings;
+        settings.compressionEnabled = compressionEnabled;
+        KeyValueStore kvStore(settings);
+        for (size_t i = 1; i < 300; ++i) {
+            std::string key(i % 50 + 1, 'k');
+            key += std::to_string(i);
+            std::string value(i, static_cast<char>('a' + i % 26));
+            ASSERT_TRUE(kvStore.set(key.c_str(), value.c_str()));
+        }
+        for (size_t i = 1; i < 300; ++i) {
+            std::string key(i % 50 + 1, 'k');
+            key += std::to_string(i);
+            std::string value(i, static_cast<char>('a' + i % 26));
+            ASSERT_STREQ(kvStore.get(key.c_str()), value.c_str());
+        }
+    }
+}
+
+// Test keys which differ only at the very end of a long common prefix
+TEST(KeyValueStoreTest, LongCommonPrefixKeys) {
+    KeyValueStore kvStore;
+    const std::string prefix = "user:session:0123456789abcdef0123456789abcdef:";
+    for (int i = 0; i < 5000; ++i) {
+        auto key = prefix + std::to_string(i);
+        ASSERT_TRUE(kvStore.set(key.c_str(), std::to_string(i).c_str()));
+    }
+    for (int i = 0; i < 5000; ++i) {
+        auto key = prefix + std::to_string(i);
+        ASSERT_STREQ(kvStore.get(key.c_str()), std::to_string(i).c_str());
+    }
+    ASSERT_EQ(kvStore.get(prefix.c_str()), nullptr);
+    ASSERT_EQ(kvStore.get((prefix + "5000").c_str()), nullptr);
+}
+
+// Test keys and values containing zero bytes, with and without compression
+TEST(KeyValueStoreTest, BinarySafeKeysAndValues) {
+    for (auto compressionEnabled : {false, true}) {
+        KeyValueStoreSettings settings;
+        settings.compressionEnabled = compressionEnabled;
+        KeyValueStore kvStore(settings);
+        for (int i = 0; i < 1000; ++i) {
+            std::string key("bin\0key", 7);
+            key += std::to_string(i);
+            std::string value(static_cast<size_t>(i % 100), '\0');
+            value += "tail\0" + std::to_string(i);
+            ASSERT_TRUE(kvStore.set(key.data(), key.size(), value.data(), value.size()));
+        }
+        for (int i = 0; i < 1000; ++i) {
+            std::string key("bin\0key", 7);
+            key += std::to_string(i);
+            std::string value(static_cast<size_t>(i % 100), '\0');
+            value += "tail\0" + std::to_string(i);
+            auto stored = kvStore.get(key.data(), key.size());
+            ASSERT_TRUE(stored);
+            ASSERT_EQ(std::string(stored.data, stored.size), value);
+        }
+        // Prefix up to the first zero byte is a different key
+        ASSERT_FALSE(kvStore.get("bin", 3));
+        ASSERT_EQ(kvStore.get("bin"), nullptr);
+
+        std::string empty;
+        ASSERT_TRUE(kvStore.set(empty.data(), 0, empty.data(), 0));
+        auto stored = kvStore.get(empty.data(), 0);
+        ASSERT_TRUE(stored);
+        ASSERT_EQ(stored.size, 0u);
+        ASSERT_TRUE(kvStore.del(empty.data(), 0));
+        ASSERT_FALSE(kvStore.get(empty.data(), 0));
+    }
+}
+
+// Test lazy expiration on access, EXPIRE, TTL and PERSIST
+TEST(KeyValueStoreTest, KeyExpiration) {
+    KeyValueStore kvStore;
+    ASSERT_TRUE(kvStore.set("short", 5, "lived", 5, hashFunc("short", 5), 20));
+    ASSERT_TRUE(kvStore.set("long", 4, "lived", 5, hashFunc("long", 4), 60000));
+    ASSERT_TRUE(kvStore.set("forever", "lived"));
+    ASSERT_TRUE(kvStore.set("persisted", 9, "lived", 5, hashFunc("persisted", 9), 20));
+
+    auto ttl = kvStore.ttl("long", 4, hashFunc("long", 4));
+    ASSERT_GT(ttl, 59000);
+    ASSERT_LE(ttl, 60000);
+    ASSERT_EQ(kvStore.ttl("forever", 7, hashFunc("forever", 7)), TTL_NO_EXPIRY);
+    ASSERT_EQ(kvStore.ttl("missing", 7, hashFunc("missing", 7)), TTL_KEY_NOT_FOUND);
+    ASSERT_TRUE(kvStore.persist("persisted", 9, hashFunc("persisted", 9)));
+    ASSERT_FALSE(kvStore.persist("forever", 7, hashFunc("forever", 7)));
+    ASSERT_TRUE(kvStore.expire("forever", 7, hashFunc("forever", 7), 20));
+    ASSERT_FALSE(kvStore.expire("missing", 7, hashFunc("missing", 7), 20));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+
+    ASSERT_EQ(kvStore.get("short"), nullptr);
+    ASSERT_EQ(kvStore.get("forever"), nullptr);
+    ASSERT_STREQ(kvStore.get("long"), "lived");
+    ASSERT_STREQ(kvStore.get("persisted"), "lived");
+    ASSERT_EQ(kvStore.ttl("short", 5, hashFunc("short", 5)), TTL_KEY_NOT_FOUND);
+    ASSERT_EQ(kvStore.getNumExpired(), 2u);
+
+    // Plain SET drops TTL, non positive EXPIRE deletes the key
+    ASSERT_TRUE(kvStore.set("long", "again"));
+    ASSERT_EQ(kvStore.ttl("long", 4, hashFunc("long", 4)), TTL_NO_EXPIRY);
+    ASSERT_TRUE(kvStore.expire("long", 4, hashFunc("long", 4), 0));
+    ASSERT_EQ(kvStore.get("long"), nullptr);
+}
+
+// Test active expiration removes keys without access, in bounded steps
+TEST(KeyValueStoreTest, ActiveExpiration) {
+    KeyValueStore kvStore;
+    const int numKeys = 5000;
+    for (int i = 0; i < numKeys; ++i) {
+        auto key = "ttl" + std::to_string(i);
+        auto ttlMs = i % 2 ? 20 : 60000;
+        ASSERT_TRUE(kvStore.set(key.data(), key.size(), "v", 1, hashFunc(key.data(), key.size()), ttlMs));
+    }
+    // Overwritten without TTL, its scheduled expiration must be ignored
+    ASSERT_TRUE(kvStore.set("ttl1", "kept"));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+
+    int steps = 0;
+    while (kvStore.removeExpired(100)) {
+        ++steps;
+    }
+    ASSERT_GE(steps, numKeys / 2 / 100 - 1);
+    ASSERT_EQ(kvStore.getNumExpired(), static_cast<uint_fast64_t>(numKeys / 2 - 1));
+    ASSERT_EQ(kvStore.getNumEntries(), static_cast<uint_fast64_t>(numKeys / 2 + 1));
+    ASSERT_STREQ(kvStore.get("ttl1"), "kept");
+    ASSERT_STREQ(kvStore.get("ttl0"), "v");
+}
+
+// Test memory limit is enforced by LRU eviction and accounting drops to zero when the store is empty
+TEST(KeyValueStoreTest, MemoryLimitLRU) {
+    KeyValueStoreSettings settings;
+    settings.compressionEnabled = false;
+    settings.maxMemory = 256 * 1024;
+    KeyValueStore kvStore(settings);
+    const std::string value(100, 'v');
+    for (int i = 0; i < 20000; ++i) {
+        auto key = "key" + std::to_string(i);
+        ASSERT_TRUE(kvStore.set(key.c_str(), value.c_str()));
+        ASSERT_LE(kvStore.getUsedMemory(), settings.maxMemory);
+    }
+    ASSERT_GT(kvStore.getNumEvictions(), 0u);
+    ASSERT_GT(kvStore.getEvictedBytes(), kvStore.getNumEvictions() * value.size());
+    ASSERT_EQ(kvStore.getNumEvictions() + kvStore.getNumEntries(), 20000u);
+    ASSERT_STREQ(kvStore.get("key19999"), value.c_str());
+
+    // Value larger than the whole limit can not be stored
+    std::string huge(settings.maxMemory, 'h');
+    ASSERT_FALSE(kvStore.set("huge", huge.c_str()));
+    ASSERT_TRUE(kvStore.isOutOfMemory());
+
+    for (int i = 0; i < 20000; ++i) {
+        kvStore.del(("key" + std::to_string(i)).c_str());
+    }
+    ASSERT_EQ(kvStore.getNumEntries(), 0u);
+    ASSERT_EQ(kvStore.getUsedMemory(), 0u);
+}
+
+// Test that stashed keys are evicted too, so writes keep succeeding when most of the memory is held by stashed values
+TEST(KeyValueStoreTest, MemoryLimitStashedKeys) {
+    KeyValueStoreSettings settings;
+    settings.compressionEnabled = false;
+    settings.maxMemory = 48 * 1024;
+    KeyValueStore kvStore(settings);
+    const uint_fast64_t hash = 42;
+    const int chainSlots = MAX_READ_WRITE_ATTEMPTS * BUCKET_SIZE;
+    const int stashSlots = OVERFLOW_STASH_MIN_BUCKETS * BUCKET_SIZE;
+    const std::string value(1000, 'v');
+    auto key = [](int i) { return "colliding" + std::to_string(i); };
+    for (int i = 0; i < chainSlots; ++i) {
+        ASSERT_TRUE(kvStore.set(key(i).data(), key(i).size(), "v", 1, hash));
+    }
+    for (int i = chainSlots; i < chainSlots + stashSlots; ++i) {
+        ASSERT_TRUE(kvStore.set(key(i).data(), key(i).size(), value.data(), value.size(), hash));
+    }
+    ASSERT_EQ(kvStore.getNumStashed(), stashSlots);
+    ASSERT_EQ(kvStore.getNumEvictions(), 0u);
+    for (int i = 0; i < chainSlots; ++i) {
+        ASSERT_TRUE(kvStore.del(key(i).data(), key(i).size(), hash));
+    }
+
+    // Only stashed values can make room for a value larger than the free memory
+    std::string large(settings.maxMemory - kvStore.getUsedMemory() + 2 * value.size(), 'l');
+    ASSERT_TRUE(kvStore.set("large", 5, large.data(), large.size()));
+    ASSERT_LE(kvStore.getNumStashed(), stashSlots - 2);
+    ASSERT_STREQ(kvStore.get("large"), large.c_str());
+
+    for (int i = 0; i < 200; ++i) {
+        auto other = "key" + std::to_string(i);
+        ASSERT_TRUE(kvStore.set(other.data(), other.size(), value.data(), value.size())) << i;
+        ASSERT_LE(kvStore.getUsedMemory(), settings.maxMemory);
+    }
+    // Keys written within the same second are equally old for LRU, victims among them are picked at random
+    ASSERT_LT(kvStore.getNumStashed(), stashSlots);
+    ASSERT_EQ(kvStore.getNumEvictions() + kvStore.getNumEntries(), 201u + stashSlots);
+}
+
+// Test frequently accessed keys survive LFU eviction
+TEST(KeyValueStoreTest, MemoryLimitLFU) {
+    KeyValueStoreSettings settings;
+    settings.compressionEnabled = false;
+    settings.maxMemory = 128 * 1024;
+    settings.evictionPolicy = EvictionPolicy::LFU;
+    settings.evictionSamples = 10;
+    KeyValueStore kvStore(settings);
+    const std::string value(100, 'v');
+    const int numHot = 50;
+    for (int i = 0; i < numHot; ++i) {
+        ASSERT_TRUE(kvStore.set(("hot" + std::to_string(i)).c_str(), value.c_str()));
+    }
+    for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < numHot; ++i) {
+            ASSERT_NE(kvStore.get(("hot" + std::to_string(i)).c_str()), nullptr);
+        }
+    }
+    for (int i = 0; i < 10000; ++i) {
+        ASSERT_TRUE(kvStore.set(("cold" + std::to_string(i)).c_str(), value.c_str()));
+    }
+    ASSERT_GT(kvStore.getNumEvictions(), 0u);
+    int survived = 0;
+    for (int i = 0; i < numHot; ++i) {
+        survived += kvStore.get(("hot" + std::to_string(i)).c_str()) != nullptr;
+    }
+    ASSERT_GE(survived, numHot * 9 / 10);
+}
+
+// Test writes are rejected instead of evicting keys with noeviction policy
+TEST(KeyValueStoreTest, MemoryLimitNoEviction) {
+    KeyValueStoreSettings settings;
+    settings.compressionEnabled = false;
+    settings.maxMemory = 64 * 1024;
+    settings.evictionPolicy = EvictionPolicy::NoEviction;
+    KeyValueStore kvStore(settings);
+    const std::string value(100, 'v');
+    int stored = 0;
+    while (kvStore.set(("key" + std::to_string(stored)).c_str(), value.c_str())) {
+        ++stored;
+    }
+    ASSERT_TRUE(kvStore.isOutOfMemory());
+    ASSERT_GT(stored, 0);
+    ASSERT_EQ(kvStore.getNumEvictions(), 0u);
+    ASSERT_EQ(kvStore.getNumEntries(), static_cast<uint_fast64_t>(stored));
+    ASSERT_STREQ(kvStore.get("key0"), value.c_str());
+    ASSERT_TRUE(kvStore.del("key0"));
+    ASSERT_TRUE(kvStore.set("key0", value.c_str()));
+}
+
+// Test timing wheel fires records in time across levels and respects the budget
+TEST(TimingWheelTest, AdvanceAcrossLevels) {
+    TimingWheel wheel(0);
+    std::vector<uint_fast64_t> delays = {0, 5, 10, 630, 640, 650, 40950, 41000, 2621440, 2700000, 200000000};
+    for (uint32_t i = 0; i < delays.size(); ++i) {
+        wheel.schedule(TimerRecord{ delays[i], i, i });
+    }
+    ASSERT_EQ(wheel.size(), delays.size());
+
+    std::vector<TimerRecord> due;
+    uint_fast64_t now = 0;
+    size_t fired = 0;
+    while (wheel.size()) {
+        now += 7;
+        due.clear();
+        while (wheel.advance(now, due, 2));
+        fired += due.size();
+        for (auto &record : due) {
+            ASSERT_LE(record.expiresAt, now);
+            ASSERT_GT(record.expiresAt + TIMING_WHEEL_RESOLUTION_MS + 7, now);
+        }
+        if (now > 2800000 && now < 199999990) {
+            now = 199999990;
+        }
+    }
+    ASSERT_EQ(fired, delays.size());
+}
+
+// Test slab allocator size classes, chunk reuse and occupancy stats
+TEST(SlabAllocatorTest, AllocateAndRelease) {
+    ASSERT_EQ(SlabAllocator::chunkSizeOf(SlabAllocator::sizeClassOf(1)), 16u);
+    ASSERT_EQ(SlabAllocator::chunkSizeOf(SlabAllocator::sizeClassOf(128)), 128u);
+    ASSERT_EQ(SlabAllocator::chunkSizeOf(SlabAllocator::sizeClassOf(129)), 160u);
+    ASSERT_EQ(SlabAllocator::chunkSizeOf(SlabAllocator::sizeClassOf(500)), 512u);
+    for (size_t size = 1; size <= SLAB_MAX_CHUNK_SIZE; ++size) {
+        auto chunkSize = SlabAllocator::chunkSizeOf(SlabAllocator::sizeClassOf(size));
+        ASSERT_GE(chunkSize, size);
+        ASSERT_LE(chunkSize, size + size / 4 + 16);
+    }
+
+    SlabAllocator allocator;
+    std::vector<char*> chunks;
+    for (size_t i = 0; i < 10000; ++i) {
+        auto chunk = allocator.allocate(100);
+        memset(chunk, static_cast<int>(i), 100);
+        chunks.push_back(chunk);
+    }
+    auto huge = allocator.allocate(SLAB_MAX_CHUNK_SIZE + 1);
+
+    auto stats = allocator.getStats();
+    auto &cls = stats.classes[SlabAllocator::sizeClassOf(100)];
+    ASSERT_EQ(cls.chunkSize, 112u);
+    ASSERT_EQ(cls.usedChunks, 10000u);
+    ASSERT_GE(cls.totalChunks, 10000u);
+    ASSERT_EQ(cls.requestedBytes, 1000000u);
+    ASSERT_EQ(stats.numHugeAllocations, 1u);
+    ASSERT_GT(stats.fragmentationRatio(), 0.0);
+    ASSERT_LT(stats.fragmentationRatio(), 0.2);
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        ASSERT_EQ(chunks[i][99], static_cast<char>(i));
+        allocator.deallocate(chunks[i], 100);
+    }
+    allocator.deallocate(huge, SLAB_MAX_CHUNK_SIZE + 1);
+
+    stats = allocator.getStats();
+    ASSERT_EQ(stats.classes[SlabAllocator::sizeClassOf(100)].usedChunks, 0u);
+    ASSERT_LE(stats.classes[SlabAllocator::sizeClassOf(100)].numSlabs, 1u);
+    ASSERT_EQ(stats.hugeBytes, 0u);
+}
+
+// Test that parallelFor covers every index exactly once, also with several callers sharing the helpers
+TEST(HelperPoolTest, ParallelFor) {
+    HelperPool pool(3);
+    ASSERT_EQ(pool.getNumHelpers(), 3);
+    std::vector<std::atomic<int>> visits(100000);
+    auto countVisits = [&visits](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            visits[i].fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+    pool.parallelFor(visits.size(), 1000, 3, countVisits);
+    pool.parallelFor(0, 1000, 3, countVisits);
+    pool.parallelFor(visits.size(), visits.size(), 3, countVisits);
+    std::vector<std::thread> callers;
+    for (int i = 0; i < 4; ++i) {
+        callers.emplace_back([&pool, &visits, &countVisits] {
+            for (int round = 0; round < 10; ++round) {
+                pool.parallelFor(visits.size(), 777, 2, countVisits);
+            }
+        });
+    }
+    for (auto &caller : callers) {
+        caller.join();
+    }
+    for (auto &count : visits) {
+        ASSERT_EQ(count.load(), 42);
+    }
+}
+
+// Test that pool growth keeps entry references valid and released entries are reused
+TEST(MemoryPoolTest, SegmentedGrowth) {
+    MemoryPool pool(10);
+    auto first = pool.allocate();
+    first.entry.hash = 42;
+    std::vector<size_t> indices;
+    for (int i = 0; i < 100000; ++i) {
+        auto pooled = pool.allocate();
+        pooled.entry.hash = pooled.i;
+        pooled.entry.isInline = true;
+        indices.push_back(pooled.i);
+    }
+    ASSERT_GE(pool.getCapacity(), 100001u);
+    ASSERT_EQ(&first.entry, &pool.get(first.i));
+    ASSERT_EQ(first.entry.hash, 42u);
+    for (auto i : indices) {
+        ASSERT_EQ(pool.get(i).hash, i);
+    }
+
+    auto capacity = pool.getCapacity();
+    for (auto i : indices) {
+        pool.deallocate(i);
+    }
+    for (int i = 0; i < 100000; ++i) {
+        pool.allocate().entry.isInline = true;
+    }
+    ASSERT_EQ(pool.getCapacity(), capacity);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,172 @@
+#include "slab_allocator.hpp"
+#include <new>
+
+using namespace kvs;
+
+SlabAllocator::~SlabAllocator() {
+    // Chunks are owned by the store which releases them before the allocator is destroyed, only empty slabs are left here
+    for (auto &cls : classes) {
+        while (cls.partial) {
+            auto *slab = cls.partial;
+            cls.partial = slab->next;
+            std::free(slab);
+        }
+    }
+}
+
+inline void SlabAllocator::linkPartial(SizeClass &cls, Slab *slab) noexcept {
+    slab->prev = nullptr;
+    slab->next = cls.partial;
+    if (cls.partial) {
+        cls.partial->prev = slab;
+    }
+    cls.partial = slab;
+}
+
+inline void SlabAllocator::unlinkPartial(SizeClass &cls, Slab *slab) noexcept {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        cls.partial = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->prev = slab->next = nullptr;
+}
+
+SlabAllocator::Slab* SlabAllocator::newSlab(uint32_t sizeClass) {
+    auto *memory = std::aligned_alloc(SLAB_SIZE, SLAB_SIZE);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    auto *slab = static_cast<Slab*>(memory);
+    slab->prev = slab->next = nullptr;
+    slab->freeList = nullptr;
+    slab->unused = static_cast<char*>(memory) + SLAB_HEADER_SIZE;
+    slab->usedChunks = 0;
+    slab->capacity = static_cast<uint32_t>((SLAB_SIZE - SLAB_HEADER_SIZE) / chunkSizeOf(sizeClass));
+    slab->sizeClass = sizeClass;
+    ++classes[sizeClass].numSlabs;
+    return slab;
+}
+
+void SlabAllocator::releaseSlab(Slab *slab) {
+    --classes[slab->sizeClass].numSlabs;
+    std::free(slab);
+}
+
+char* SlabAllocator::allocate(size_t size) {
+    if (size > SLAB_MAX_CHUNK_SIZE) {
+        hugeBytes += size;
+        ++numHugeAllocations;
+        return new char[size];
+    }
+
+    auto sizeClass = sizeClassOf(size);
+    auto &cls = classes[sizeClass];
+    auto *slab = cls.partial;
+    if (!slab) {
+        slab = newSlab(sizeClass);
+        linkPartial(cls, slab);
+    }
+
+    char *chunk;
+    if (slab->freeList) {
+        chunk = slab->freeList;
+        slab->freeList = *reinterpret_cast<char**>(chunk);
+    } else {
+        chunk = slab->unused;
+        slab->unused += chunkSizeOf(sizeClass);
+    }
+
+    if (++slab->usedChunks == slab->capacity) {
+        unlinkPartial(cls, slab);
+    }
+    ++cls.usedChunks;
+    cls.requestedBytes += size;
+    return chunk;
+}
+
+void SlabAllocator::deallocate(char *ptr, size_t size) noexcept {
+    if (!ptr) {
+        return;
+    }
+    if (size > SLAB_MAX_CHUNK_SIZE) {
+        hugeBytes -= size;
+        --numHugeAllocations;
+        delete[] ptr;
+        return;
+    }
+
+    auto *slab = reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(ptr) & ~static_cast<uintptr_t>(SLAB_SIZE - 1));
+    auto &cls = classes[slab->sizeClass];
+    --cls.usedChunks;
+    cls.requestedBytes -= size;
+
+    *reinterpret_cast<char**>(ptr) = slab->freeList;
+    slab->freeList = ptr;
+
+    if (slab->usedChunks-- == slab->capacity) {
+        linkPartial(cls, slab);
+    }
+
+    // Keep one partial slab per class to avoid thrashing on alternating allocate / deallocate
+    if (slab->usedChunks == 0 && (slab->prev || slab->next)) {
+        unlinkPartial(cls, slab);
+        releaseSlab(slab);
+    }
+}
+
+SlabAllocatorStats SlabAllocator::getStats() const noexcept {
+    SlabAllocatorStats stats;
+    for (uint32_t i = 0; i < SLAB_NUM_CLASSES; ++i) {
+        auto &cls = classes[i];
+        auto &clsStats = stats.classes[i];
+        clsStats.chunkSize = static_cast<uint_fast32_t>(chunkSizeOf(i));
+        clsStats.numSlabs = cls.numSlabs;
+        clsStats.usedChunks = cls.usedChunks;
+        clsStats.totalChunks = cls.numSlabs * ((SLAB_SIZE - SLAB_HEADER_SIZE) / chunkSizeOf(i));
+        clsStats.requestedBytes = cls.requestedBytes;
+    }
+    stats.hugeBytes = hugeBytes;
+    stats.numHugeAllocations = numHugeAllocations;
+    return stats;
+}
+
+uint_fast64_t SlabAllocatorStats::allocatedBytes() const noexcept {
+    uint_fast64_t total = hugeBytes;
+    for (auto &cls : classes) {
+        total += cls.numSlabs * SLAB_SIZE;
+    }
+    return total;
+}
+
+uint_fast64_t SlabAllocatorStats::requestedBytes() const noexcept {
+    uint_fast64_t total = hugeBytes;
+    for (auto &cls : classes) {
+        total += cls.requestedBytes;
+    }
+    return total;
+}
+
+double SlabAllocatorStats::fragmentationRatio() const noexcept {
+    auto allocated = allocatedBytes();
+    if (!allocated) {
+        return 0.0;
+    }
+    return 1.0 - static_cast<double>(requestedBytes()) / static_cast<double>(allocated);
+}
+
+SlabAllocatorStats& SlabAllocatorStats::operator+=(const SlabAllocatorStats& other) noexcept {
+    for (uint32_t i = 0; i < SLAB_NUM_CLASSES; ++i) {
+        classes[i].chunkSize = other.classes[i].chunkSize;
+        classes[i].numSlabs += other.classes[i].numSlabs;
+        classes[i].usedChunks += other.classes[i].usedChunks;
+        classes[i].totalChunks += other.classes[i].totalChunks;
+        classes[i].requestedBytes += other.classes[i].requestedBytes;
+    }
+    hugeBytes += other.hugeBytes;
+    numHugeAllocations += other.numHugeAllocations;
+    return *this;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <array>
+#include <bit>
+#include "../non_copyable.hpp"
+
+/// @brief Size of a single slab, slabs are aligned to their size so the owning slab is found from a chunk pointer
+#define SLAB_SIZE 65536
+/// @brief Allocations larger than this bypass slabs and go straight to the heap
+#define SLAB_MAX_CHUNK_SIZE 16384
+/// @brief Number of size classes: 8 classes of 16 byte steps up to 128 bytes, then 4 classes per power of two up to SLAB_MAX_CHUNK_SIZE
+#define SLAB_NUM_CLASSES 36
+
+namespace kvs
+{
+    /// @brief Occupancy of a single size class
+    struct SlabClassStats {
+        uint_fast32_t chunkSize = 0;
+        uint_fast64_t numSlabs = 0;
+        uint_fast64_t usedChunks = 0;
+        uint_fast64_t totalChunks = 0;
+        /// @brief Sum of sizes requested by callers for the used chunks, the rest of used chunk bytes is internal fragmentation
+        uint_fast64_t requestedBytes = 0;
+    };
+
+    struct SlabAllocatorStats {
+        std::array<SlabClassStats, SLAB_NUM_CLASSES> classes{};
+        /// @brief Bytes of allocations which did not fit into any size class
+        uint_fast64_t hugeBytes = 0;
+        uint_fast64_t numHugeAllocations = 0;
+
+        /// @brief Memory held by slabs and huge allocations
+        uint_fast64_t allocatedBytes() const noexcept;
+        /// @brief Memory requested by callers
+        uint_fast64_t requestedBytes() const noexcept;
+        /// @brief Share of allocated memory which does not hold requested data: 0 - no waste, 1 - everything is wasted
+        double fragmentationRatio() const noexcept;
+
+        SlabAllocatorStats& operator+=(const SlabAllocatorStats& other) noexcept;
+    };
+
+    /// @brief Size-class slab allocator for key and value bytes. Not thread safe, every shard owns its own instance
+    class SlabAllocator : NonCopyableOrMovable {
+        private:
+            struct Slab {
+                Slab *prev;
+                Slab *next;
+                char *freeList;
+                char *unused;
+                uint32_t usedChunks;
+                uint32_t capacity;
+                uint32_t sizeClass;
+            };
+
+            struct SizeClass {
+                /// @brief Slabs which have at least one free chunk
+                Slab *partial = nullptr;
+                uint_fast64_t numSlabs = 0;
+                uint_fast64_t usedChunks = 0;
+                uint_fast64_t requestedBytes = 0;
+            };
+
+            static constexpr size_t SLAB_HEADER_SIZE = (sizeof(Slab) + 63) & ~static_cast<size_t>(63);
+
+            std::array<SizeClass, SLAB_NUM_CLASSES> classes{};
+            uint_fast64_t hugeBytes = 0;
+            uint_fast64_t numHugeAllocations = 0;
+
+            Slab* newSlab(uint32_t sizeClass);
+            void releaseSlab(Slab *slab);
+            void linkPartial(SizeClass &cls, Slab *slab) noexcept;
+            void unlinkPartial(SizeClass &cls, Slab *slab) noexcept;
+
+        public:
+            SlabAllocator() = default;
+            ~SlabAllocator();
+
+            /// @brief Allocates memory for size bytes, memory must be returned via deallocate with the same size
+            char* allocate(size_t size);
+            void deallocate(char *ptr, size_t size) noexcept;
+
+            SlabAllocatorStats getStats() const noexcept;
+
+            static constexpr uint32_t sizeClassOf(size_t size) noexcept {
+                if (size <= 128) {
+                    return size == 0 ? 0 : static_cast<uint32_t>((size + 15) / 16 - 1);
+                }
+                uint32_t k = std::bit_width(size - 1) - 1;
+                size_t step = size_t(1) << (k - 2);
+                return 8 + (k - 7) * 4 + static_cast<uint32_t>((size - (size_t(1) << k) - 1) / step);
+            }
+
+            static constexpr size_t chunkSizeOf(uint32_t sizeClass) noexcept {
+                if (sizeClass < 8) {
+                    return (sizeClass + 1) * 16;
+                }
+                uint32_t k = 7 + (sizeClass - 8) / 4;
+                return (size_t(1) << k) + ((sizeClass - 8) % 4 + 1) * (size_t(1) << (k - 2));
+            }
+    };
+
+    static_assert(SlabAllocator::chunkSizeOf(SLAB_NUM_CLASSES - 1) == SLAB_MAX_CHUNK_SIZE);
+    static_assert(SlabAllocator::sizeClassOf(SLAB_MAX_CHUNK_SIZE) == SLAB_NUM_CLASSES - 1);
+}
@@ -0,0 +1,81 @@
+#include "timing_wheel.hpp"
+#include <algorithm>
+
+using namespace kvs;
+
+TimingWheel::TimingWheel(uint_fast64_t nowMs): currentTick(nowMs / TIMING_WHEEL_RESOLUTION_MS) {
+}
+
+void TimingWheel::place(const TimerRecord &record) {
+    auto tick = std::max(tickOf(record.expiresAt), currentTick);
+    auto delta = tick - currentTick;
+    if (delta > MAX_DELTA) {
+        // Too far in the future, park it in the last level, it is placed again with the real expiration time when cascaded
+        tick = currentTick + MAX_DELTA;
+        delta = MAX_DELTA;
+    }
+    int level = 0;
+    while (level < TIMING_WHEEL_LEVELS - 1 && delta >= (uint_fast64_t(1) << (TIMING_WHEEL_SLOT_BITS * (level + 1)))) {
+        ++level;
+    }
+    levels[level][(tick >> (TIMING_WHEEL_SLOT_BITS * level)) & SLOT_MASK].push_back(record);
+    ++numRecords;
+}
+
+void TimingWheel::schedule(const TimerRecord &record) {
+    place(record);
+}
+
+bool TimingWheel::advance(uint_fast64_t nowMs, std::vector<TimerRecord> &due, size_t budget) {
+    auto nowTick = nowMs / TIMING_WHEEL_RESOLUTION_MS;
+    if (numRecords == 0) {
+        currentTick = std::max(currentTick, nowTick + 1);
+        cascadeLevel = -1;
+        return false;
+    }
+
+    while (currentTick <= nowTick) {
+        if (cascadeLevel < 0) {
+            // Slots of upper levels are moved down when lower level completes a full turn
+            cascadeLevel = 0;
+            while (cascadeLevel < TIMING_WHEEL_LEVELS - 1
+                && (currentTick & ((uint_fast64_t(1) << (TIMING_WHEEL_SLOT_BITS * (cascadeLevel + 1))) - 1)) == 0) {
+                ++cascadeLevel;
+            }
+        }
+
+        for (; cascadeLevel > 0; --cascadeLevel) {
+            auto &slot = levels[cascadeLevel][(currentTick >> (TIMING_WHEEL_SLOT_BITS * cascadeLevel)) & SLOT_MASK];
+            while (!slot.empty()) {
+                if (budget == 0) {
+                    return true;
+                }
+                auto record = slot.back();
+                slot.pop_back();
+                --numRecords;
+                --budget;
+                place(record);
+            }
+        }
+
+        auto &slot = levels[0][currentTick & SLOT_MASK];
+        while (!slot.empty()) {
+            if (budget == 0) {
+                return true;
+            }
+            auto record = slot.back();
+            slot.pop_back();
+            --numRecords;
+            --budget;
+            if (tickOf(record.expiresAt) > currentTick) {
+                place(record);
+                continue;
+            }
+            due.push_back(record);
+        }
+
+        ++currentTick;
+        cascadeLevel = -1;
+    }
+    return false;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include "../non_copyable.hpp"
+
+/// @brief Time covered by a single level 0 slot
+#define TIMING_WHEEL_RESOLUTION_MS 10
+/// @brief Number of slots per level, must be a power of two
+#define TIMING_WHEEL_SLOT_BITS 6
+/// @brief Number of levels, every next level covers TIMING_WHEEL_SLOTS times longer period (4 levels of 64 slots with 10ms resolution cover ~46 hours)
+#define TIMING_WHEEL_LEVELS 4
+
+namespace kvs
+{
+    /// @brief Scheduled expiration of a pool entry, hash and expiresAt are used to detect records made stale by overwrite, PERSIST or delete
+    struct TimerRecord {
+        uint_fast64_t expiresAt;
+        uint_fast64_t hash;
+        uint32_t entryIdx;
+    };
+
+    /// @brief Hierarchical timing wheel with O(1) scheduling. Records are never removed on cancel, they are validated by the owner when they fire.
+    /// Not thread safe, every shard owns its own instance
+    class TimingWheel : NonCopyableOrMovable {
+        private:
+            static constexpr uint_fast64_t SLOTS = uint_fast64_t(1) << TIMING_WHEEL_SLOT_BITS;
+            static constexpr uint_fast64_t SLOT_MASK = SLOTS - 1;
+            static constexpr uint_fast64_t MAX_DELTA = (uint_fast64_t(1) << (TIMING_WHEEL_SLOT_BITS * TIMING_WHEEL_LEVELS)) - 1;
+
+            std::array<std::array<std::vector<TimerRecord>, SLOTS>, TIMING_WHEEL_LEVELS> levels{};
+            /// @brief Next tick to be processed, all slots before it are already drained
+            uint_fast64_t currentTick;
+            /// @brief Highest level which is still being cascaded down for currentTick, -1 when currentTick is not prepared yet
+            int cascadeLevel = -1;
+            size_t numRecords = 0;
+
+            static uint_fast64_t tickOf(uint_fast64_t timeMs) noexcept {
+                return (timeMs + TIMING_WHEEL_RESOLUTION_MS - 1) / TIMING_WHEEL_RESOLUTION_MS;
+            }
+
+            void place(const TimerRecord &record);
+
+        public:
+            explicit TimingWheel(uint_fast64_t nowMs);
+
+            void schedule(const TimerRecord &record);
+
+            /// @brief Collects records which are due at nowMs, moves (cascades or collects) at most budget records
+            /// @return true if the budget was exhausted before the wheel caught up with nowMs
+            bool advance(uint_fast64_t nowMs, std::vector<TimerRecord> &due, size_t budget);
+
+            size_t size() const noexcept {
+                return numRecords;
+            }
+    };
+}
@@ -0,0 +1,48 @@
+#include "value_cache.hpp"
+
+using namespace kvs;
+
+ValueCacheStats& ValueCacheStats::operator+=(const ValueCacheStats& other) noexcept {
+    hits += other.hits;
+    misses += other.misses;
+    usedBytes += other.usedBytes;
+    numValues += other.numValues;
+    return *this;
+}
+
+std::string_view ValueCache::find(uint32_t entryIdx) {
+    auto it = index.find(entryIdx);
+    if (it == index.end()) {
+        ++stats.misses;
+        return {};
+    }
+    ++stats.hits;
+    lru.splice(lru.begin(), lru, it->second);
+    return { it->second->data.get(), it->second->size };
+}
+
+std::string_view ValueCache::insert(uint32_t entryIdx, char *data, size_t size) {
+    if (size + 1 > capacity) {
+        return {};
+    }
+    erase(entryIdx);
+    while (stats.usedBytes + size + 1 > capacity) {
+        erase(lru.back().entryIdx);
+    }
+    lru.push_front(Node { entryIdx, std::unique_ptr<char[]>(data), size });
+    index.emplace(entryIdx, lru.begin());
+    stats.usedBytes += size + 1;
+    ++stats.numValues;
+    return { data, size };
+}
+
+void ValueCache::erase(uint32_t entryIdx) {
+    auto it = index.find(entryIdx);
+    if (it == index.end()) {
+        return;
+    }
+    stats.usedBytes -= it->second->size + 1;
+    --stats.numValues;
+    lru.erase(it->second);
+    index.erase(it);
+}
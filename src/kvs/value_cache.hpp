@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include "../non_copyable.hpp"
+
+/// @brief Default capacity of the decompressed value cache of a single store
+#define VALUE_CACHE_DEFAULT_SIZE (1 << 20)
+
+namespace kvs
+{
+    struct ValueCacheStats {
+        uint_fast64_t hits = 0;
+        uint_fast64_t misses = 0;
+        /// @brief Bytes of cached values including zero terminators
+        uint_fast64_t usedBytes = 0;
+        uint_fast64_t numValues = 0;
+
+        /// @brief Share of lookups served from the cache, 0 if there were none
+        double hitRatio() const noexcept {
+            return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0;
+        }
+
+        ValueCacheStats& operator+=(const ValueCacheStats& other) noexcept;
+    };
+
+    /// @brief Bounded LRU cache of decompressed values keyed by entry pool index, so repeated reads of a compressed value skip decompression.
+    /// The owner erases an index whenever the value at it changes or the entry is released. Not thread safe, every shard owns its own instance
+    class ValueCache : NonCopyableOrMovable {
+        private:
+            struct Node {
+                uint32_t entryIdx;
+                std::unique_ptr<char[]> data;
+                size_t size;
+            };
+
+            /// @brief Most recently used values first
+            std::list<Node> lru;
+            std::unordered_map<uint32_t, std::list<Node>::iterator> index;
+            size_t capacity;
+            ValueCacheStats stats;
+
+        public:
+            /// @param capacity Max bytes of cached values, 0 disables caching
+            explicit ValueCache(size_t capacity) : capacity(capacity) {}
+
+            /// @brief Looks up the value of an entry and marks it as most recently used
+            /// @return View of the cached value, data is nullptr on miss
+            std::string_view find(uint32_t entryIdx);
+
+            /// @brief Takes ownership of a new[] allocated, zero terminated value and evicts least recently used values to fit it
+            /// @return View of the cached value, data is nullptr if the value is larger than the whole cache, in that case the ownership stays with the caller
+            std::string_view insert(uint32_t entryIdx, char *data, size_t size);
+
+            void erase(uint32_t entryIdx);
+
+            bool empty() const noexcept {
+                return index.empty();
+            }
+
+            const ValueCacheStats& getStats() const noexcept {
+                return stats;
+            }
+    };
+}
@@ -7,6 +7,42 @@
 
 using namespace server;
 
+static EvictionPolicy parseEvictionPolicy(const char* policy) {
+    if (strcasecmp(policy, "lru") == 0) {
+        return EvictionPolicy::LRU;
+    }
+    if (strcasecmp(policy, "lfu") == 0) {
+        return EvictionPolicy::LFU;
+    }
+    if (strcasecmp(policy, "noeviction") == 0) {
+        return EvictionPolicy::NoEviction;
+    }
+    std::cerr << "Unknown EVICTION_POLICY = " << policy << ", expected one of: lru, lfu, noeviction\n";
+    std::exit(1);
+}
+
+static bool parseTableSizes(const char* sizes) {
+    if (strcasecmp(sizes, "prime") == 0) {
+        return true;
+    }
+    if (strcasecmp(sizes, "pow2") == 0) {
+        return false;
+    }
+    std::cerr << "Unknown TABLE_SIZES = " << sizes << ", expected one of: prime, pow2\n";
+    std::exit(1);
+}
+
+static CodecId parseValueCodec(const char* codec) {
+    if (strcasecmp(codec, "lz4") == 0) {
+        return CodecId::Lz4;
+    }
+    if (strcasecmp(codec, "gzip") == 0) {
+        return CodecId::Gzip;
+    }
+    std::cerr << "Unknown VALUE_CODEC = " << codec << ", expected one of: lz4, gzip\n";
+    std::exit(1);
+}
+
 int main() {
     MetricsChannel serverChannel;
 
@@ -22,8 +58,23 @@ int main() {
     auto connQueueLimit = getFromEnv<uint_fast32_t>("CONN_QUEUE_LIMIT", false, 1048576);
     auto enableCompression = getFromEnv<bool>("ENABLE_COMPRESSION", false, true);
     auto respInlineCapacity = getFromEnv<std::size_t>("RESP_INLINE_CAPACITY", false, static_cast<std::size_t>(255));
+    auto incrementalResize = getFromEnv<bool>("INCREMENTAL_RESIZE", false, true);
+    auto expirationBudgetUsec = getFromEnv<uint_fast32_t>("EXPIRATION_BUDGET_USEC", false, 250);
+    auto maxMemory = getFromEnv<uint_fast64_t>("MAX_MEMORY", false, 0);
+    auto evictionPolicy = parseEvictionPolicy(getFromEnv<const char*>("EVICTION_POLICY", false, "lru"));
+    auto usePrimeTableSizes = parseTableSizes(getFromEnv<const char*>("TABLE_SIZES", false, "prime"));
+    auto compressionLevel = getFromEnv<int>("COMPRESSION_LEVEL", false, GZIP_DEFAULT_LEVEL);
+    auto valueCodec = parseValueCodec(getFromEnv<const char*>("VALUE_CODEC", false, "lz4"));
+    auto dictionarySize = getFromEnv<std::size_t>("DICTIONARY_SIZE", false, static_cast<std::size_t>(DICT_DEFAULT_SIZE));
+    auto minCompressionSavings = getFromEnv<uint_fast32_t>("MIN_COMPRESSION_SAVINGS", false, MIN_COMPRESSION_SAVINGS_PERCENT);
+    auto compressColdAfterMs = getFromEnv<uint_fast64_t>("COMPRESS_COLD_AFTER_MS", false, 0);
+    auto valueCacheSize = getFromEnv<uint_fast64_t>("VALUE_CACHE_SIZE", false, 64 * 1024 * 1024);
+    auto respFraming = getFromEnv<bool>("RESP_FRAMING", false, false);
+    auto rehashThreads = getFromEnv<uint_fast32_t>("REHASH_THREADS", false, 1);
 
-    ServerSettings serverSettings { serverPort, numShards, sockBufferSize, connQueueLimit, enableCompression, respInlineCapacity };
+    ServerSettings serverSettings { serverPort, numShards, sockBufferSize, connQueueLimit, enableCompression, respInlineCapacity, incrementalResize, expirationBudgetUsec,
+                                    maxMemory, evictionPolicy, usePrimeTableSizes, compressionLevel, valueCodec, dictionarySize, minCompressionSavings,
+                                    compressColdAfterMs, valueCacheSize, respFraming, rehashThreads };
 
     CacheServer cacheServer { serverSettings };
 
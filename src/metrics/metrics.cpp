@@ -31,6 +31,112 @@ void MetricsServer::RegisterMetrics()
                         .Help("Total number of server requests")
                         .Register(*registry)
                         .Add({});
+
+    kvs_expired_keys_total = &BuildCounter()
+                        .Name("kvs_expired_keys_total")
+                        .Help("Total number of keys removed because their TTL elapsed")
+                        .Register(*registry)
+                        .Add({});
+
+    kvs_evicted_keys_total = &BuildCounter()
+                        .Name("kvs_evicted_keys_total")
+                        .Help("Total number of keys evicted because of the memory limit")
+                        .Register(*registry)
+                        .Add({});
+
+    kvs_evicted_bytes_total = &BuildCounter()
+                        .Name("kvs_evicted_bytes_total")
+                        .Help("Total number of bytes released by evictions")
+                        .Register(*registry)
+                        .Add({});
+
+    kvs_used_memory_bytes = &BuildGauge()
+                        .Name("kvs_used_memory_bytes")
+                        .Help("Memory used by entries, keys and values, limited by MAX_MEMORY")
+                        .Register(*registry)
+                        .Add({});
+
+    kvs_max_memory_bytes = &BuildGauge()
+                        .Name("kvs_max_memory_bytes")
+                        .Help("Configured memory limit, 0 - unlimited")
+                        .Register(*registry)
+                        .Add({});
+
+    kvs_allocated_bytes = &BuildGauge()
+                        .Name("kvs_allocated_bytes")
+                        .Help("Memory held by slabs and huge allocations for keys and values")
+                        .Register(*registry)
+                        .Add({});
+
+    kvs_requested_bytes = &BuildGauge()
+                        .Name("kvs_requested_bytes")
+                        .Help("Memory requested for keys and values")
+                        .Register(*registry)
+                        .Add({});
+
+    kvs_fragmentation_ratio = &BuildGauge()
+                        .Name("kvs_fragmentation_ratio")
+                        .Help("Share of allocated key and value memory which does not hold data")
+                        .Register(*registry)
+                        .Add({});
+
+    kvs_huge_allocations = &BuildGauge()
+                        .Name("kvs_huge_allocations")
+                        .Help("Number of key and value allocations which bypass slabs")
+                        .Register(*registry)
+                        .Add({});
+
+    kvs_value_cache_hits_total = &BuildCounter()
+                        .Name("kvs_value_cache_hits_total")
+                        .Help("Total number of GETs of compressed values served from the decompressed value cache")
+                        .Register(*registry)
+                        .Add({});
+
+    kvs_value_cache_misses_total = &BuildCounter()
+                        .Name("kvs_value_cache_misses_total")
+                        .Help("Total number of GETs of compressed values which had to decompress the value")
+                        .Register(*registry)
+                        .Add({});
+
+    kvs_value_cache_hit_ratio = &BuildGauge()
+                        .Name("kvs_value_cache_hit_ratio")
+                        .Help("Share of GETs of compressed values served from the decompressed value cache since start")
+                        .Register(*registry)
+                        .Add({});
+
+    kvs_value_cache_bytes = &BuildGauge()
+                        .Name("kvs_value_cache_bytes")
+                        .Help("Memory used by decompressed values in the value cache, limited by VALUE_CACHE_SIZE")
+                        .Register(*registry)
+                        .Add({});
+
+    kvs_value_cache_values = &BuildGauge()
+                        .Name("kvs_value_cache_values")
+                        .Help("Number of decompressed values in the value cache")
+                        .Register(*registry)
+                        .Add({});
+
+    auto& slabUsedChunks = BuildGauge()
+                        .Name("kvs_slab_used_chunks")
+                        .Help("Number of used chunks per slab size class")
+                        .Register(*registry);
+
+    auto& slabTotalChunks = BuildGauge()
+                        .Name("kvs_slab_total_chunks")
+                        .Help("Number of chunks per slab size class")
+                        .Register(*registry);
+
+    auto& slabRequestedBytes = BuildGauge()
+                        .Name("kvs_slab_requested_bytes")
+                        .Help("Bytes requested for used chunks per slab size class")
+                        .Register(*registry);
+
+    for (uint32_t i = 0; i < SLAB_NUM_CLASSES; ++i) {
+        auto sizeClass = std::to_string(SlabAllocator::chunkSizeOf(i));
+        kvs_slab_used_chunks[i] = &slabUsedChunks.Add({{"size_class", sizeClass}});
+        kvs_slab_total_chunks[i] = &slabTotalChunks.Add({{"size_class", sizeClass}});
+        kvs_slab_requested_bytes[i] = &slabRequestedBytes.Add({{"size_class", sizeClass}});
+    }
 }
 
 MetricsServer::MetricsServer(std::string metrics_url)
@@ -51,4 +157,38 @@ void MetricsServer::UpdateMetrics(CacheServerMetrics& serverMetrics)
 
     auto numRequestsInc = serverMetrics.numRequests - server_num_requests_total->Value();
     server_num_requests_total->Increment(numRequestsInc);
+
+    auto numExpiredKeysInc = serverMetrics.numExpiredKeys - kvs_expired_keys_total->Value();
+    kvs_expired_keys_total->Increment(numExpiredKeysInc);
+
+    auto numEvictionsInc = serverMetrics.numEvictions - kvs_evicted_keys_total->Value();
+    kvs_evicted_keys_total->Increment(numEvictionsInc);
+
+    auto evictedBytesInc = serverMetrics.evictedBytes - kvs_evicted_bytes_total->Value();
+    kvs_evicted_bytes_total->Increment(evictedBytesInc);
+
+    kvs_used_memory_bytes->Set(serverMetrics.usedMemory);
+    kvs_max_memory_bytes->Set(serverMetrics.maxMemory);
+
+    auto& valueCacheStats = serverMetrics.valueCacheStats;
+    auto valueCacheHitsInc = valueCacheStats.hits - kvs_value_cache_hits_total->Value();
+    kvs_value_cache_hits_total->Increment(valueCacheHitsInc);
+
+    auto valueCacheMissesInc = valueCacheStats.misses - kvs_value_cache_misses_total->Value();
+    kvs_value_cache_misses_total->Increment(valueCacheMissesInc);
+
+    kvs_value_cache_hit_ratio->Set(valueCacheStats.hitRatio());
+    kvs_value_cache_bytes->Set(valueCacheStats.usedBytes);
+    kvs_value_cache_values->Set(valueCacheStats.numValues);
+
+    auto& memoryStats = serverMetrics.memoryStats;
+    kvs_allocated_bytes->Set(memoryStats.allocatedBytes());
+    kvs_requested_bytes->Set(memoryStats.requestedBytes());
+    kvs_fragmentation_ratio->Set(memoryStats.fragmentationRatio());
+    kvs_huge_allocations->Set(memoryStats.numHugeAllocations);
+    for (uint32_t i = 0; i < SLAB_NUM_CLASSES; ++i) {
+        kvs_slab_used_chunks[i]->Set(memoryStats.classes[i].usedChunks);
+        kvs_slab_total_chunks[i]->Set(memoryStats.classes[i].totalChunks);
+        kvs_slab_requested_bytes[i]->Set(memoryStats.classes[i].requestedBytes);
+    }
 }
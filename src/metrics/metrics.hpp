@@ -23,6 +23,24 @@ namespace metrics
             Counter* server_num_requests_total = nullptr;
             Counter* server_num_errors_total = nullptr;
 
+            Counter* kvs_expired_keys_total = nullptr;
+            Counter* kvs_evicted_keys_total = nullptr;
+            Counter* kvs_evicted_bytes_total = nullptr;
+            Gauge* kvs_used_memory_bytes = nullptr;
+            Gauge* kvs_max_memory_bytes = nullptr;
+            Gauge* kvs_allocated_bytes = nullptr;
+            Gauge* kvs_requested_bytes = nullptr;
+            Gauge* kvs_fragmentation_ratio = nullptr;
+            Gauge* kvs_huge_allocations = nullptr;
+            Counter* kvs_value_cache_hits_total = nullptr;
+            Counter* kvs_value_cache_misses_total = nullptr;
+            Gauge* kvs_value_cache_hit_ratio = nullptr;
+            Gauge* kvs_value_cache_bytes = nullptr;
+            Gauge* kvs_value_cache_values = nullptr;
+            std::array<Gauge*, SLAB_NUM_CLASSES> kvs_slab_used_chunks{};
+            std::array<Gauge*, SLAB_NUM_CLASSES> kvs_slab_total_chunks{};
+            std::array<Gauge*, SLAB_NUM_CLASSES> kvs_slab_requested_bytes{};
+
             void RegisterMetrics();
 
         public:
@@ -1,25 +1,76 @@
 #pragma once
-#include <iostream>
-#include <vector>
-#include <queue>
-#include <bitset>
-#include <cmath>
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <limits>
-#include <omp.h>
+#include <stdexcept>
 
 constexpr uint_fast64_t DEFAULT_MAX_LIMIT = 1000000000; // 1 billion is reasonable default limit
-constexpr uint_fast64_t SEGMENT_SIZE = 1000000;
+/// @brief Growth sequence starts after the default initial table size
+constexpr uint_fast64_t PRIME_SEQUENCE_START = 2053;
 
+namespace primegen_detail {
+    constexpr bool isPrime(uint_fast64_t n) {
+        if (n < 2) return false;
+        if (n % 2 == 0) return n == 2;
+        if (n % 3 == 0) return n == 3;
+        for (uint_fast64_t i = 5; i * i <= n; i += 6) {
+            if (n % i == 0 || n % (i + 2) == 0) return false;
+        }
+        return true;
+    }
+
+    /// @brief Smallest prime which is not less than n
+    constexpr uint_fast64_t nextPrime(uint_fast64_t n) {
+        while (!isPrime(n)) ++n;
+        return n;
+    }
+
+    /// @brief Smaller tables grow faster, big tables grow by small steps to limit memory overhead
+    constexpr double growthFactorOf(uint_fast64_t prime) {
+        if (prime < 100000) return 4;
+        if (prime < 1000000) return 1.5;
+        if (prime < 10000000) return 1.2;
+        if (prime < 100000000) return 1.1;
+        return 1.05;
+    }
+
+    /// @brief Walks the growth sequence, stores primes into out (if any) and returns their number
+    template<typename Out>
+    constexpr size_t walkSequence(Out *out) {
+        size_t count = 0;
+        uint_fast64_t lastStored = PRIME_SEQUENCE_START;
+        double growthFactor = 2.0;
+        while (true) {
+            auto prime = nextPrime(static_cast<uint_fast64_t>(lastStored * growthFactor));
+            if (prime >= DEFAULT_MAX_LIMIT) break;
+            if (out) (*out)[count] = prime;
+            ++count;
+            lastStored = prime;
+            growthFactor = growthFactorOf(prime);
+        }
+        return count;
+    }
+
+    constexpr size_t NUM_PRIMES = walkSequence<std::array<uint_fast64_t, 1>>(nullptr);
+
+    constexpr std::array<uint_fast64_t, NUM_PRIMES> makeSequence() {
+        std::array<uint_fast64_t, NUM_PRIMES> primes{};
+        walkSequence(&primes);
+        return primes;
+    }
+}
+
+/// @brief Table sizes used for growth, computed at compile time
+inline constexpr auto PRIME_SEQUENCE = primegen_detail::makeSequence();
+
+static_assert(PRIME_SEQUENCE.front() > 2 * PRIME_SEQUENCE_START);
+static_assert(primegen_detail::isPrime(PRIME_SEQUENCE.back()) && PRIME_SEQUENCE.back() < DEFAULT_MAX_LIMIT);
+
+/// @brief Position in PRIME_SEQUENCE, every instance walks the sequence independently
 class Primegen {
     private:
-        inline const static uint_fast64_t maxLimit = DEFAULT_MAX_LIMIT;
-        inline static std::queue<uint_fast64_t> sharedQueue;
-        inline static bool isInitialized = false;
-        static void initGenerator();
-
-        std::queue<uint_fast64_t> primeQueue;
+        size_t position = 0;
     public:
-        Primegen();
+        Primegen() = default;
         uint_fast64_t PopNext();
 };
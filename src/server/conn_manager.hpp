@@ -22,24 +22,23 @@
 
 namespace server {
     struct RespTransactionState {
-        enum class CommandType : uint8_t { Get, Set, Del };
+        enum class CommandType : uint8_t { Get, Set, Del, Expire, Ttl, Persist };
 
         struct QueuedCommand {
             CommandType type = CommandType::Get;
-            const char* key = nullptr;
-            const char* value = nullptr;
+            std::string_view key{};
+            std::string_view value{};
+            int_fast64_t ttlMs = 0;
         };
 
-        const char* persistString(const char* input) {
-            if (!input || !*input) {
-                static constexpr char EMPTY[] = "";
-                return EMPTY;
+        std::string_view persistString(std::string_view input) {
+            if (input.empty()) {
+                return std::string_view{ "", 0 };
             }
 
-            const size_t length = std::strlen(input);
-            auto buffer = std::unique_ptr<char[]>(new char[length + 1]);
-            std::memcpy(buffer.get(), input, length + 1);
-            const char* result = buffer.get();
+            auto buffer = std::unique_ptr<char[]>(new char[input.size()]);
+            std::memcpy(buffer.get(), input.data(), input.size());
+            std::string_view result{ buffer.get(), input.size() };
             storage.emplace_back(std::move(buffer));
             return result;
         }
@@ -23,12 +23,24 @@ static constexpr uint_fast32_t READ_MAX_ATTEMPTS = (MAX_REQUEST_SIZE / READ_BUFF
 /// @brief Min response size to generate asynch response
 static constexpr uint_fast32_t ASYNC_RESPONSE_SIZE_THRESHOLD = 1048576;
 
+/// @brief Min size of a RESP GET value sent from store memory instead of being copied into the response, copying smaller values is cheaper than pinning them
+static constexpr size_t ZERO_COPY_MIN_VALUE_SIZE = 1024;
+
 /// @brief Event batching delay - time to wait until next data arrival for batch processing
 static constexpr long BATCHING_DELAY_NSEC = 500000; // 0.5 msec
 
 /// @brief Starting number of event loop workers
 static constexpr uint_fast32_t BATCH_MIN_SIZE = 32;
 
+/// @brief Max number of shard maintenance steps (e.g. incremental resize batches) executed per shard on idle event loop tick
+static constexpr uint_fast32_t MAINTENANCE_STEPS_PER_IDLE_TICK = 64;
+
+/// @brief Max number of shard maintenance steps executed per shard after every handled batch of events, keeps the added latency small
+static constexpr uint_fast32_t MAINTENANCE_STEPS_PER_BUSY_BATCH = 1;
+
+/// @brief Number of scheduled key expirations examined per shard in a single active expiration step
+static constexpr uint_fast32_t EXPIRATION_RECORDS_PER_STEP = 32;
+
 /// @brief Starting number of event loop workers
 static constexpr unsigned int NUM_WORKERS = 4;
 
@@ -13,14 +13,21 @@ namespace server {
     const char NOTHING[] = "(nil)";
     const char KEY_NOT_EXISTS[] = "ERROR: Key does not exist";
     const char INTERNAL_ERROR[] = "ERROR: Internal error";
+    const char OUT_OF_MEMORY[] = "ERROR: Out of memory, write is rejected by memory limit";
     const char INVALID_COMMAND_CODE[] = "ERROR: Invalid command code";
     const char INVALID_QUERY_CODE[] = "ERROR: Invalid query code";
     const char UNKNOWN_COMMAND[] = "ERROR: Unknown command";
     const char UNABLE_TO_PARSE_REQUEST_ERROR[] = "ERROR: Unable to parse request";
     const char INVALID_COMMAND_FORMAT[] = "ERROR: Invalid command format";
+    const char INVALID_EXPIRE_TIME[] = "ERROR: Invalid expire time";
     const char GET_STR[] = "GET";
     const char SET_STR[] = "SET";
     const char DEL_STR[] = "DEL";
+    const char EXPIRE_STR[] = "EXPIRE";
+    const char TTL_STR[] = "TTL";
+    const char PERSIST_STR[] = "PERSIST";
+    const char EX_STR[] = "EX";
+    const char PX_STR[] = "PX";
 }
 
 namespace {
@@ -41,11 +48,13 @@ namespace {
     constexpr char RESP_ERR_DISCARD_NO_MULTI_PAYLOAD[] = "-ERR ERR DISCARD without MULTI\r\n";
     constexpr char RESP_ERR_EXEC_ABORTED_PAYLOAD[] = "-ERR EXECABORT Transaction discarded because of previous errors.\r\n";
     constexpr char RESP_ERR_INTERNAL_ERROR_PAYLOAD[] = "-ERR ERROR: Internal error\r\n";
+    constexpr char RESP_ERR_OUT_OF_MEMORY_PAYLOAD[] = "-ERR ERROR: Out of memory, write is rejected by memory limit\r\n";
     constexpr char RESP_ERR_INVALID_COMMAND_CODE_PAYLOAD[] = "-ERR ERROR: Invalid command code\r\n";
     constexpr char RESP_ERR_INVALID_QUERY_CODE_PAYLOAD[] = "-ERR ERROR: Invalid query code\r\n";
     constexpr char RESP_ERR_UNKNOWN_COMMAND_PAYLOAD[] = "-ERR ERROR: Unknown command\r\n";
     constexpr char RESP_ERR_UNABLE_TO_PARSE_PAYLOAD[] = "-ERR ERROR: Unable to parse request\r\n";
     constexpr char RESP_ERR_INVALID_COMMAND_FORMAT_PAYLOAD[] = "-ERR ERROR: Invalid command format\r\n";
+    constexpr char RESP_ERR_INVALID_EXPIRE_TIME_PAYLOAD[] = "-ERR ERROR: Invalid expire time\r\n";
 
     constexpr StaticResponseData SIMPLE_STRING_RESPONSES[] = {
         {server::OK, RESP_OK_SIMPLE, sizeof(RESP_OK_SIMPLE) - 1},
@@ -58,11 +67,13 @@ namespace {
         {server::RESP_ERR_DISCARD_NO_MULTI, RESP_ERR_DISCARD_NO_MULTI_PAYLOAD, sizeof(RESP_ERR_DISCARD_NO_MULTI_PAYLOAD) - 1},
         {server::RESP_ERR_EXEC_ABORTED, RESP_ERR_EXEC_ABORTED_PAYLOAD, sizeof(RESP_ERR_EXEC_ABORTED_PAYLOAD) - 1},
         {server::INTERNAL_ERROR, RESP_ERR_INTERNAL_ERROR_PAYLOAD, sizeof(RESP_ERR_INTERNAL_ERROR_PAYLOAD) - 1},
+        {server::OUT_OF_MEMORY, RESP_ERR_OUT_OF_MEMORY_PAYLOAD, sizeof(RESP_ERR_OUT_OF_MEMORY_PAYLOAD) - 1},
         {server::INVALID_COMMAND_CODE, RESP_ERR_INVALID_COMMAND_CODE_PAYLOAD, sizeof(RESP_ERR_INVALID_COMMAND_CODE_PAYLOAD) - 1},
         {server::INVALID_QUERY_CODE, RESP_ERR_INVALID_QUERY_CODE_PAYLOAD, sizeof(RESP_ERR_INVALID_QUERY_CODE_PAYLOAD) - 1},
         {server::UNKNOWN_COMMAND, RESP_ERR_UNKNOWN_COMMAND_PAYLOAD, sizeof(RESP_ERR_UNKNOWN_COMMAND_PAYLOAD) - 1},
         {server::UNABLE_TO_PARSE_REQUEST_ERROR, RESP_ERR_UNABLE_TO_PARSE_PAYLOAD, sizeof(RESP_ERR_UNABLE_TO_PARSE_PAYLOAD) - 1},
         {server::INVALID_COMMAND_FORMAT, RESP_ERR_INVALID_COMMAND_FORMAT_PAYLOAD, sizeof(RESP_ERR_INVALID_COMMAND_FORMAT_PAYLOAD) - 1},
+        {server::INVALID_EXPIRE_TIME, RESP_ERR_INVALID_EXPIRE_TIME_PAYLOAD, sizeof(RESP_ERR_INVALID_EXPIRE_TIME_PAYLOAD) - 1},
     };
 
     inline bool stringsEqual(const char* lhs, const char* rhs) noexcept {
@@ -233,6 +244,12 @@ ResponsePacket& ResponsePacket::operator=(ResponsePacket&& other) noexcept {
         }
     }
 
+    external = std::exchange(other.external, nullptr);
+    externalSize = std::exchange(other.externalSize, 0);
+    trailer = std::exchange(other.trailer, nullptr);
+    trailerSize = std::exchange(other.trailerSize, 0);
+    pin = std::move(other.pin);
+
     other.data = nullptr;
     other.size = 0;
     other.inlineIndex = RESP_INLINE_INVALID;
@@ -368,7 +385,7 @@ bool parseRespCommand(std::string_view payload, RespCommandParts& parts)
     };
 
     size_t elements = 0;
-    if (!read_num(elements) || elements < 1 || elements > 3) return false;
+    if (!read_num(elements) || elements < 1 || elements > RESP_MAX_ARGS) return false;
 
     for (size_t i = 0; i < elements; ++i) {
         if (idx >= end || data[idx] != RESP_BULK_PREFIX) return false;
@@ -384,24 +401,76 @@ bool parseRespCommand(std::string_view payload, RespCommandParts& parts)
         data[idx] = '\0';
         idx += 2;
 
-        if (i == 0)       parts.command = startPtr;
-        else if (i == 1)  parts.key     = startPtr;
-        else              parts.value   = startPtr;
+        if (i == 0)       { parts.command = startPtr; parts.commandLen = len; }
+        else if (i == 1)  { parts.key     = startPtr; parts.keyLen     = len; }
+        else if (i == 2)  { parts.value   = startPtr; parts.valueLen   = len; }
+        else              { parts.options[i - 3] = std::string_view(startPtr, len); }
     }
 
     parts.argc = elements;
     if (!parts.command) return false;
     if (elements >= 2 && !parts.key) return false;
-    if (elements == 3 && !parts.value) return false;
+    if (elements >= 3 && !parts.value) return false;
     return true;
 }
 
 ResponsePacket makeCustomResponse(const char* message)
+{
+    return makeCustomResponse(message, std::strlen(message));
+}
+
+ResponsePacket makeCustomResponse(const char* message, size_t length)
 {
     ResponsePacket response{};
     response.protocol = RequestProtocol::Custom;
     response.data = message;
-    response.size = std::strlen(message);
+    response.size = length;
+    return response;
+}
+
+ResponsePacket makeCustomResponse(const char* message, size_t length, ResponsePin pin)
+{
+    ResponsePacket response = makeCustomResponse(message, length);
+    response.pin = std::move(pin);
+    return response;
+}
+
+ResponsePacket makeCustomValue(const char* value, size_t length)
+{
+    ResponsePacket response{};
+    response.protocol = RequestProtocol::Custom;
+    char* out = response.tryUseInline(length);
+    if (!out) {
+        auto buffer = std::unique_ptr<char[]>(new char[length]);
+        out = buffer.get();
+        response.setOwnedBuffer(std::move(buffer), length);
+    }
+    if (length) std::memcpy(out, value, length);
+    return response;
+}
+
+ResponsePacket makeCustomInteger(int64_t value)
+{
+    ResponsePacket response{};
+    response.protocol = RequestProtocol::Custom;
+
+    uint64_t magnitude = value < 0 ? static_cast<uint64_t>(-(value + 1)) + 1 : static_cast<uint64_t>(value);
+    char digitsBuf[20];
+    const unsigned digits = u64_to_ascii(magnitude, digitsBuf);
+
+    const bool negative = value < 0;
+    const size_t total = (negative ? 1 : 0) + digits;
+    char* out = response.tryUseInline(total);
+    if (!out) {
+        auto buffer = std::unique_ptr<char[]>(new char[total]);
+        out = buffer.get();
+        response.setOwnedBuffer(std::move(buffer), total);
+    }
+
+    if (negative) {
+        out[0] = '-';
+    }
+    std::memcpy(out + (negative ? 1 : 0), digitsBuf, digits);
     return response;
 }
 
@@ -464,16 +533,20 @@ ResponsePacket makeRespInteger(int64_t value)
 }
 
 ResponsePacket makeRespBulkString(const char* value)
+{
+    return makeRespBulkString(value, value == NOTHING ? 0 : std::strlen(value));
+}
+
+ResponsePacket makeRespBulkString(const char* value, size_t len)
 {
     ResponsePacket response{};
     response.protocol = RequestProtocol::RESP;
 
     if (value == NOTHING) {
-        response.setStaticData(RESP_NULL_BULK, std::strlen(RESP_NULL_BULK));
+        response.setStaticData(RESP_NULL_BULK, sizeof(RESP_NULL_BULK) - 1);
         return response;
     }
 
-    const size_t len = std::strlen(value);
     char lenBuf[20];
     const unsigned digits = u64_to_ascii(len, lenBuf);
 
@@ -496,6 +569,58 @@ ResponsePacket makeRespBulkString(const char* value)
     return response;
 }
 
+ResponsePacket makeRespBulkStringRef(const char* value, size_t len, ResponsePin pin)
+{
+    ResponsePacket response{};
+    response.protocol = RequestProtocol::RESP;
+
+    char lenBuf[20];
+    const unsigned digits = u64_to_ascii(len, lenBuf);
+
+    const size_t total = 1 + digits + 2;
+    char* out = response.tryUseInline(total);
+    if (!out) {
+        auto buffer = std::unique_ptr<char[]>(new char[total]);
+        out = buffer.get();
+        response.setOwnedBuffer(std::move(buffer), total);
+    }
+
+    out[0] = RESP_BULK_PREFIX;
+    if (digits) std::memcpy(out + 1, lenBuf, digits);
+    out[1 + digits] = RESP_CR;
+    out[2 + digits] = RESP_LF;
+
+    response.external = value;
+    response.externalSize = len;
+    response.trailer = RESP_CRLF;
+    response.trailerSize = sizeof(RESP_CRLF) - 1;
+    response.pin = std::move(pin);
+    return response;
+}
+
+ResponsePacket makeRespPreframed(const char* frame, size_t length)
+{
+    ResponsePacket response{};
+    response.protocol = RequestProtocol::RESP;
+    char* out = response.tryUseInline(length);
+    if (!out) {
+        auto buffer = std::unique_ptr<char[]>(new char[length]);
+        out = buffer.get();
+        response.setOwnedBuffer(std::move(buffer), length);
+    }
+    std::memcpy(out, frame, length);
+    return response;
+}
+
+ResponsePacket makeRespPreframed(const char* frame, size_t length, ResponsePin pin)
+{
+    ResponsePacket response{};
+    response.protocol = RequestProtocol::RESP;
+    response.setStaticData(frame, length);
+    response.pin = std::move(pin);
+    return response;
+}
+
 ResponsePacket makeRespArray(const std::vector<ResponsePacket>& elements)
 {
     ResponsePacket response{};
@@ -506,7 +631,7 @@ ResponsePacket makeRespArray(const std::vector<ResponsePacket>& elements)
 
     size_t total = 1 + digits + 2;
     for (const auto& element : elements) {
-        total += element.size;
+        total += element.totalSize();
     }
 
     char* out = response.tryUseInline(total);
@@ -527,6 +652,14 @@ ResponsePacket makeRespArray(const std::vector<ResponsePacket>& elements)
             std::memcpy(out + offset, element.data, element.size);
         }
         offset += element.size;
+        if (element.externalSize) {
+            std::memcpy(out + offset, element.external, element.externalSize);
+        }
+        offset += element.externalSize;
+        if (element.trailerSize) {
+            std::memcpy(out + offset, element.trailer, element.trailerSize);
+        }
+        offset += element.trailerSize;
     }
 
     return response;
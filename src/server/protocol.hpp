@@ -23,6 +23,9 @@ namespace server {
     inline constexpr char RESP_LF = '\n';
     inline constexpr char RESP_ERROR_PREFIX[] = "-ERR ";
     inline constexpr char RESP_NULL_BULK[] = "$-1\r\n";
+    inline constexpr char RESP_CRLF[] = "\r\n";
+    /// @brief Max number of RESP command elements, e.g. SET key value EX seconds
+    inline constexpr size_t RESP_MAX_ARGS = 5;
 
     extern const char MULTI_STR[];
     extern const char EXEC_STR[];
@@ -36,26 +39,36 @@ namespace server {
     extern const char NOTHING[];
     extern const char KEY_NOT_EXISTS[];
     extern const char INTERNAL_ERROR[];
+    extern const char OUT_OF_MEMORY[];
     extern const char INVALID_COMMAND_CODE[];
     extern const char INVALID_QUERY_CODE[];
     extern const char UNKNOWN_COMMAND[];
     extern const char UNABLE_TO_PARSE_REQUEST_ERROR[];
     extern const char INVALID_COMMAND_FORMAT[];
+    extern const char INVALID_EXPIRE_TIME[];
 
     extern const char GET_STR[];
     extern const char SET_STR[];
     extern const char DEL_STR[];
-    /// @brief Query codes, 0: Reserved, 1: GET
+    extern const char EXPIRE_STR[];
+    extern const char TTL_STR[];
+    extern const char PERSIST_STR[];
+    extern const char EX_STR[];
+    extern const char PX_STR[];
+    /// @brief Query codes, 0: Reserved, 1: GET, 2: TTL
     enum QueryCode : uint_fast8_t {
         UnknownQuery = 0,
         GET = 1,
+        TTL = 2,
     };
 
-    /// @brief Command codes, 0: Reserved, 1: SET
+    /// @brief Command codes, 0: Reserved, 1: SET, 2: DEL, 3: EXPIRE, 4: PERSIST
     enum CommandCode : uint_fast8_t {
         UnknownCommand = 0,
         SET = 1,
         DEL = 2,
+        EXPIRE = 3,
+        PERSIST = 4,
     };
 
     enum class RequestProtocol : uint_fast8_t {
@@ -63,12 +76,55 @@ namespace server {
         RESP = 1,
     };
 
+    /// @brief Keeps memory referenced by a response alive, release is called once when the pin is reset or destroyed
+    class ResponsePin {
+        public:
+            using ReleaseFunc = void (*)(void* owner) noexcept;
+
+            ResponsePin() = default;
+            ResponsePin(ReleaseFunc release, void* owner) noexcept : release(release), owner(owner) {}
+            ResponsePin(ResponsePin&& other) noexcept
+                : release(std::exchange(other.release, nullptr)), owner(std::exchange(other.owner, nullptr)) {}
+            ResponsePin& operator=(ResponsePin&& other) noexcept {
+                if (this != &other) {
+                    reset();
+                    release = std::exchange(other.release, nullptr);
+                    owner = std::exchange(other.owner, nullptr);
+                }
+                return *this;
+            }
+            ResponsePin(const ResponsePin&) = delete;
+            ResponsePin& operator=(const ResponsePin&) = delete;
+            ~ResponsePin() noexcept { reset(); }
+
+            void reset() noexcept {
+                if (release) {
+                    release(owner);
+                    release = nullptr;
+                    owner = nullptr;
+                }
+            }
+
+            explicit operator bool() const noexcept { return release != nullptr; }
+
+        private:
+            ReleaseFunc release = nullptr;
+            void* owner = nullptr;
+    };
+
+    /// @brief Response bytes are data, then external, then trailer. External bytes are not copied (e.g. a stored value) and stay valid while pin is alive
     struct ResponsePacket {
         RequestProtocol protocol = RequestProtocol::Custom;
         const char* data = nullptr;
         size_t size = 0;
         std::unique_ptr<char[]> owned;
         uint16_t inlineIndex = std::numeric_limits<uint16_t>::max();
+        const char* external = nullptr;
+        size_t externalSize = 0;
+        /// @brief Static bytes sent after external ones, e.g. RESP_CRLF
+        const char* trailer = nullptr;
+        size_t trailerSize = 0;
+        ResponsePin pin;
 
         ResponsePacket() = default;
         ResponsePacket(ResponsePacket&& other) noexcept { *this = std::move(other); }
@@ -82,6 +138,7 @@ namespace server {
         void setStaticData(const char* ptr, size_t length) noexcept;
 
         bool usesInlineStorage() const noexcept { return inlineIndex != std::numeric_limits<uint16_t>::max(); }
+        size_t totalSize() const noexcept { return size + externalSize + trailerSize; }
     };
 
     struct RequestView {
@@ -89,10 +146,16 @@ namespace server {
         RequestProtocol protocol = RequestProtocol::Custom;
     };
 
+    /// @brief Arguments of a RESP command, pointers reference the request buffer. Lengths are authoritative, arguments may contain zero bytes
     struct RespCommandParts {
         char* command = nullptr;
         char* key = nullptr;
         char* value = nullptr;
+        size_t commandLen = 0;
+        size_t keyLen = 0;
+        size_t valueLen = 0;
+        /// @brief Arguments following the value, e.g. EX seconds
+        std::array<std::string_view, RESP_MAX_ARGS - 3> options{};
         size_t argc = 0;
     };
 
@@ -111,9 +174,22 @@ namespace server {
     bool parseRespCommand(std::string_view payload, RespCommandParts& parts);
 
     ResponsePacket makeCustomResponse(const char* message);
+    ResponsePacket makeCustomResponse(const char* message, size_t length);
+    /// @brief Custom protocol response which references message without copying it, pin keeps message alive until the response is destroyed
+    ResponsePacket makeCustomResponse(const char* message, size_t length, ResponsePin pin);
+    /// @brief Custom protocol response holding a copy of value
+    ResponsePacket makeCustomValue(const char* value, size_t length);
+    ResponsePacket makeCustomInteger(int64_t value);
     ResponsePacket makeRespSimpleString(const char* message);
     ResponsePacket makeRespInteger(int64_t value);
     ResponsePacket makeRespBulkString(const char* value);
+    ResponsePacket makeRespBulkString(const char* value, size_t length);
+    /// @brief Bulk string which references value without copying it, only the length header is built. Pin keeps value alive until the response is destroyed
+    ResponsePacket makeRespBulkStringRef(const char* value, size_t length, ResponsePin pin);
+    /// @brief Copies an already encoded RESP reply, e.g. a value stored with its bulk string framing
+    ResponsePacket makeRespPreframed(const char* frame, size_t length);
+    /// @brief References an already encoded RESP reply without copying it, pin keeps frame alive until the response is destroyed
+    ResponsePacket makeRespPreframed(const char* frame, size_t length, ResponsePin pin);
     ResponsePacket makeRespArray(const std::vector<ResponsePacket>& elements);
     ResponsePacket makeRespError(const char* message);
     ResponsePacket makeErrorResponse(RequestProtocol protocol, const char* message);
@@ -45,6 +45,32 @@ TEST(RespProtocolTest, ParseRespCommandSet)
     ASSERT_STREQ(parts.value, "value");
 }
 
+TEST(RespProtocolTest, ParseRespCommandBinaryValue)
+{
+    std::string payload("*3\r\n$3\r\nSET\r\n$4\r\nk\0\r\n\r\n$6\r\nv\r\n\0\0x\r\n", 35);
+    RespCommandParts parts{};
+    ASSERT_TRUE(parseRespCommand(payload, parts));
+    ASSERT_EQ(parts.argc, 3u);
+    ASSERT_EQ(std::string(parts.command, parts.commandLen), SET_STR);
+    ASSERT_EQ(std::string(parts.key, parts.keyLen), std::string("k\0\r\n", 4));
+    ASSERT_EQ(std::string(parts.value, parts.valueLen), std::string("v\r\n\0\0x", 6));
+}
+
+TEST(RespProtocolTest, ParseRespCommandSetWithExpiration)
+{
+    std::string payload = "*5\r\n$3\r\nSET\r\n$3\r\nkey\r\n$5\r\nvalue\r\n$2\r\nEX\r\n$2\r\n10\r\n";
+    RespCommandParts parts{};
+    ASSERT_TRUE(parseRespCommand(payload, parts));
+    ASSERT_EQ(parts.argc, 5u);
+    ASSERT_STREQ(parts.value, "value");
+    ASSERT_EQ(parts.options[0], EX_STR);
+    ASSERT_EQ(parts.options[1], "10");
+
+    std::string tooLong = "*6\r\n$3\r\nSET\r\n$1\r\nk\r\n$1\r\nv\r\n$2\r\nEX\r\n$2\r\n10\r\n$2\r\nNX\r\n";
+    RespCommandParts rejected{};
+    ASSERT_FALSE(parseRespCommand(tooLong, rejected));
+}
+
 TEST(RespProtocolTest, MakeRespSimpleString)
 {
     auto response = makeRespSimpleString(OK);
@@ -90,6 +116,14 @@ TEST(RespProtocolTest, MakeRespBulkString)
     ASSERT_EQ(serialized, "$5\r\nhello\r\n");
 }
 
+TEST(RespProtocolTest, MakeRespBulkStringBinary)
+{
+    const char value[] = {'a', '\0', 'b'};
+    auto response = makeRespBulkString(value, sizeof(value));
+    std::string serialized(response.data, response.size);
+    ASSERT_EQ(serialized, std::string("$3\r\na\0b\r\n", 9));
+}
+
 TEST(RespProtocolTest, MakeRespInteger)
 {
     auto positive = makeRespInteger(1);
@@ -119,6 +153,58 @@ TEST(RespProtocolTest, MakeRespArray)
     ASSERT_EQ(serialized, "*3\r\n+OK\r\n:1\r\n$5\r\nvalue\r\n");
 }
 
+namespace {
+    void countRelease(void* counter) noexcept {
+        ++*static_cast<int*>(counter);
+    }
+}
+
+TEST(RespProtocolTest, MakeRespBulkStringRef)
+{
+    int released = 0;
+    std::string value(4096, 'v');
+    {
+        auto response = makeRespBulkStringRef(value.data(), value.size(), ResponsePin(countRelease, &released));
+        ASSERT_EQ(response.protocol, RequestProtocol::RESP);
+        ASSERT_EQ(std::string(response.data, response.size), "$4096\r\n");
+        ASSERT_EQ(response.external, value.data());
+        ASSERT_EQ(response.externalSize, value.size());
+        ASSERT_EQ(std::string(response.trailer, response.trailerSize), "\r\n");
+        ASSERT_EQ(response.totalSize(), 7 + value.size() + 2);
+
+        // Pin moves along with the response and is released exactly once
+        ResponsePacket moved = std::move(response);
+        ASSERT_EQ(response.external, nullptr);
+        ASSERT_EQ(released, 0);
+
+        std::vector<ResponsePacket> elements;
+        elements.emplace_back(std::move(moved));
+        elements.emplace_back(makeRespInteger(1));
+        auto array = makeRespArray(elements);
+        ASSERT_EQ(std::string(array.data, array.size), "*2\r\n$4096\r\n" + value + "\r\n:1\r\n");
+        ASSERT_EQ(array.external, nullptr);
+        ASSERT_EQ(released, 0);
+    }
+    ASSERT_EQ(released, 1);
+}
+
+TEST(RespProtocolTest, MakeRespPreframed)
+{
+    const std::string frame = "$5\r\nvalue\r\n";
+    auto copied = makeRespPreframed(frame.data(), frame.size());
+    ASSERT_EQ(copied.protocol, RequestProtocol::RESP);
+    ASSERT_NE(copied.data, frame.data());
+    ASSERT_EQ(std::string(copied.data, copied.size), frame);
+
+    int released = 0;
+    {
+        auto referenced = makeRespPreframed(frame.data(), frame.size(), ResponsePin(countRelease, &released));
+        ASSERT_EQ(referenced.data, frame.data());
+        ASSERT_EQ(referenced.totalSize(), frame.size());
+    }
+    ASSERT_EQ(released, 1);
+}
+
 TEST(RespProtocolTest, MakeRespNullBulkString)
 {
     auto response = makeRespBulkString(NOTHING);
@@ -165,3 +251,27 @@ TEST(CustomProtocolTest, MakeCustomResponse)
     ASSERT_EQ(response.size, std::strlen(OK));
     ASSERT_EQ(response.owned, nullptr);
 }
+
+TEST(CustomProtocolTest, MakeCustomValue)
+{
+    std::string value("stored\0value", 12);
+    auto copied = makeCustomValue(value.data(), value.size());
+    ASSERT_NE(copied.data, value.data());
+    ASSERT_EQ(std::string(copied.data, copied.size), value);
+
+    int released = 0;
+    {
+        auto referenced = makeCustomResponse(value.data(), value.size(), ResponsePin(countRelease, &released));
+        ASSERT_EQ(referenced.data, value.data());
+        ASSERT_EQ(referenced.totalSize(), value.size());
+    }
+    ASSERT_EQ(released, 1);
+}
+
+TEST(CustomProtocolTest, MakeCustomInteger)
+{
+    auto positive = makeCustomInteger(42);
+    ASSERT_EQ(std::string(positive.data, positive.size), "42");
+    auto negative = makeCustomInteger(-2);
+    ASSERT_EQ(std::string(negative.data, negative.size), "-2");
+}
@@ -1,13 +1,62 @@
 #include "server.hpp"
 #include <unordered_map>
+#include <charconv>
+#include <limits>
+#include <climits>
 #include <string>
 #include <vector>
 
 using namespace server;
 
+namespace {
+    /// @brief Parses expiration time argument, e.g. EX 10
+    /// @param unitMs milliseconds per argument unit, 1000 for seconds, 1 for milliseconds
+    bool parseExpireTime(std::string_view text, int_fast64_t unitMs, int_fast64_t& ttlMs) {
+        int_fast64_t amount = 0;
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), amount);
+        if (ec != std::errc{} || ptr != text.data() + text.size()) {
+            return false;
+        }
+        if (amount > std::numeric_limits<int_fast64_t>::max() / unitMs || amount < std::numeric_limits<int_fast64_t>::min() / unitMs) {
+            return false;
+        }
+        ttlMs = amount * unitMs;
+        return true;
+    }
+
+    /// @brief Redis reports TTL in seconds rounded to the nearest second
+    int_fast64_t ttlToSeconds(int_fast64_t ttlMs) {
+        return ttlMs < 0 ? ttlMs : (ttlMs + 500) / 1000;
+    }
+
+    void unpinStore(void* store) noexcept {
+        static_cast<KeyValueStore*>(store)->unpin();
+    }
+
+    /// @brief Fills iovecs with non-empty segments of a response, out must have room for 3 of them
+    /// @return Number of iovecs filled
+    size_t fillResponseIovecs(const ResponsePacket& response, iovec* out) noexcept {
+        size_t count = 0;
+        const std::pair<const char*, size_t> segments[] = {
+            { response.data, response.size },
+            { response.external, response.externalSize },
+            { response.trailer, response.trailerSize },
+        };
+        for (auto& [data, size] : segments) {
+            if (size) {
+                out[count].iov_base = const_cast<char*>(data);
+                out[count].iov_len = size;
+                ++count;
+            }
+        }
+        return count;
+    }
+}
+
 ConnectionData::~ConnectionData() = default;
 
-CacheServer::CacheServer(const ServerSettings settings): numShards(settings.numShards), port(settings.port)
+CacheServer::CacheServer(const ServerSettings settings):
+    numShards(settings.numShards), expirationBudget(settings.expirationBudgetUsec), maxMemory(settings.maxMemory), port(settings.port)
 {
     setRespInlineCapacity(settings.respInlineCapacity);
 
@@ -80,7 +129,17 @@ CacheServer::CacheServer(const ServerSettings settings): numShards(settings.numS
     std::cout << "Initializing " << numShards << " server shards…\n";
 #endif
     serverShards.reserve(numShards);
-    KeyValueStoreSettings kvsSettings { 2053, settings.enableCompression, true };
+    KeyValueStoreSettings kvsSettings { 2053, settings.enableCompression, settings.usePrimeTableSizes, settings.incrementalResize };
+    kvsSettings.maxMemory = numShards ? settings.maxMemory / numShards : 0;
+    kvsSettings.evictionPolicy = settings.evictionPolicy;
+    kvsSettings.compressionLevel = settings.compressionLevel;
+    kvsSettings.codec = settings.valueCodec;
+    kvsSettings.dictionarySize = settings.dictionarySize;
+    kvsSettings.minCompressionSavings = settings.minCompressionSavings;
+    kvsSettings.compressColdAfterMs = settings.compressColdAfterMs;
+    kvsSettings.valueCacheSize = numShards ? settings.valueCacheSize / numShards : 0;
+    kvsSettings.respFraming = settings.respFraming;
+    kvsSettings.rehashThreads = settings.rehashThreads ? settings.rehashThreads : std::max(std::thread::hardware_concurrency(), 1u);
     for (int i = 0; i < numShards; ++i) {
         serverShards.emplace_back(i, kvsSettings);
     }
@@ -106,20 +165,97 @@ ProcessRequestTask server::CacheServer::processRequest(const RequestView& reques
     co_await sendTask;
 }
 
+void CacheServer::prepareRequest(PreparedRequest& prepared)
+{
+    const auto& payload = prepared.request.payload;
+    if (prepared.request.protocol == RequestProtocol::RESP) {
+        prepared.parsed = parseRespCommand(payload, prepared.parts);
+        if (prepared.parsed && prepared.parts.key) {
+            prepared.key = {prepared.parts.key, prepared.parts.keyLen};
+        }
+        return;
+    }
+
+    // Same key extraction as the custom protocol branch of processRequestSync
+    const auto firstSpace = payload.find(' ');
+    if (firstSpace == std::string_view::npos || firstSpace + 1 == payload.size()) {
+        return;
+    }
+    const auto remainder = payload.substr(firstSpace + 1);
+    prepared.key = remainder.substr(0, remainder.find(' '));
+}
+
+void CacheServer::hashPreparedKeys(std::vector<PreparedRequest>& batch)
+{
+    batchKeys.clear();
+    for (auto& prepared : batch) {
+        if (prepared.key.data()) {
+            batchKeys.push_back(prepared.key);
+        }
+    }
+    batchHashes.resize(batchKeys.size());
+    hashFuncBatch(batchKeys.data(), batchKeys.size(), batchHashes.data());
+    size_t i = 0;
+    for (auto& prepared : batch) {
+        if (prepared.key.data()) {
+            prepared.keyHash = batchHashes[i++];
+        }
+    }
+}
+
 ResponsePacket CacheServer::processRequestSync(const RequestView& request, ConnectionData& connData)
 {
-    auto handleGet = [&](const char* keyPtr, RequestProtocol protocol) -> ResponsePacket {
-        auto hash = hashFunc(keyPtr);
-        auto& shard = serverShards[hash % numShards];
-        Query query{QueryCode::GET, keyPtr, hash};
-        const char* result = shard.processQuery(query);
-        return protocol == RequestProtocol::RESP ? makeRespBulkString(result) : makeCustomResponse(result);
+    PreparedRequest prepared{request};
+    prepareRequest(prepared);
+    if (prepared.key.data()) {
+        prepared.keyHash = hashFunc(prepared.key.data(), prepared.key.size());
+    }
+    return processRequestSync(prepared, connData);
+}
+
+ResponsePacket CacheServer::processRequestSync(PreparedRequest& prepared, ConnectionData& connData)
+{
+    const auto& request = prepared.request;
+
+    // Keys of transaction commands are copies queued earlier, they are hashed when executed
+    auto hashOf = [&](std::string_view key) -> uint_fast64_t {
+        if (prepared.key.data() && key.data() == prepared.key.data() && key.size() == prepared.key.size()) {
+            return prepared.keyHash;
+        }
+        return hashFunc(key.data(), key.size());
+    };
+
+    auto handleGet = [&](std::string_view key, RequestProtocol protocol) -> ResponsePacket {
+        auto hash = hashOf(key);
+        auto& shard = serverShards[shardIndex(hash, numShards)];
+        Query query{QueryCode::GET, key, hash};
+        auto result = shard.processQuery(query);
+        // Values stored with RESP framing are sent as is, custom protocol replies skip the framing
+        auto frame = protocol == RequestProtocol::RESP ? result.respFrame() : std::string_view{};
+        // Large stored values are sent straight from store memory, the pin keeps them alive until the response is destroyed
+        if (result.pinnable && (protocol == RequestProtocol::Custom || std::max(frame.size(), result.size) >= ZERO_COPY_MIN_VALUE_SIZE)) {
+            shard.keyValueStore->pin();
+            ResponsePin pin(unpinStore, shard.keyValueStore.get());
+            if (!frame.empty()) {
+                return makeRespPreframed(frame.data(), frame.size(), std::move(pin));
+            }
+            return protocol == RequestProtocol::RESP ? makeRespBulkStringRef(result.data, result.size, std::move(pin))
+                                                     : makeCustomResponse(result.data, result.size, std::move(pin));
+        }
+        if (!frame.empty()) {
+            return makeRespPreframed(frame.data(), frame.size());
+        }
+        if (protocol == RequestProtocol::RESP) {
+            return makeRespBulkString(result.data, result.size);
+        }
+        // Decompressed and inline values may be gone after the next store operation, copy them
+        return result.data == NOTHING ? makeCustomResponse(NOTHING) : makeCustomValue(result.data, result.size);
     };
 
-    auto handleSet = [&](const char* keyPtr, const char* valuePtr, RequestProtocol protocol) -> ResponsePacket {
-        auto hash = hashFunc(keyPtr);
-        auto& shard = serverShards[hash % numShards];
-        Command cmd{CommandCode::SET, keyPtr, valuePtr, hash};
+    auto handleSet = [&](std::string_view key, std::string_view value, int_fast64_t ttlMs, RequestProtocol protocol) -> ResponsePacket {
+        auto hash = hashOf(key);
+        auto& shard = serverShards[shardIndex(hash, numShards)];
+        Command cmd{CommandCode::SET, key, value, hash, ttlMs};
         const char* result = shard.processCommand(cmd);
         if (protocol == RequestProtocol::RESP) {
             return (result && std::strcmp(result, OK) == 0) ? makeRespSimpleString(result) : makeRespError(result);
@@ -127,10 +263,11 @@ ResponsePacket CacheServer::processRequestSync(const RequestView& request, Conne
         return makeCustomResponse(result);
     };
 
-    auto handleDel = [&](const char* keyPtr, RequestProtocol protocol) -> ResponsePacket {
-        auto hash = hashFunc(keyPtr);
-        auto& shard = serverShards[hash % numShards];
-        Command cmd{CommandCode::DEL, keyPtr, nullptr, hash};
+    // DEL, EXPIRE and PERSIST reply with 1 if the key was affected and 0 otherwise
+    auto handleKeyCommand = [&](CommandCode code, std::string_view key, int_fast64_t ttlMs, RequestProtocol protocol) -> ResponsePacket {
+        auto hash = hashOf(key);
+        auto& shard = serverShards[shardIndex(hash, numShards)];
+        Command cmd{code, key, {}, hash, ttlMs};
         const char* result = shard.processCommand(cmd);
         if (protocol == RequestProtocol::RESP) {
             if (result && std::strcmp(result, OK) == 0) {
@@ -144,6 +281,26 @@ ResponsePacket CacheServer::processRequestSync(const RequestView& request, Conne
         return makeCustomResponse(result);
     };
 
+    auto handleDel = [&](std::string_view key, RequestProtocol protocol) -> ResponsePacket {
+        return handleKeyCommand(CommandCode::DEL, key, 0, protocol);
+    };
+
+    auto handleExpire = [&](std::string_view key, int_fast64_t ttlMs, RequestProtocol protocol) -> ResponsePacket {
+        return handleKeyCommand(CommandCode::EXPIRE, key, ttlMs, protocol);
+    };
+
+    auto handlePersist = [&](std::string_view key, RequestProtocol protocol) -> ResponsePacket {
+        return handleKeyCommand(CommandCode::PERSIST, key, 0, protocol);
+    };
+
+    auto handleTtl = [&](std::string_view key, RequestProtocol protocol) -> ResponsePacket {
+        auto hash = hashOf(key);
+        auto& shard = serverShards[shardIndex(hash, numShards)];
+        Query query{QueryCode::TTL, key, hash};
+        auto seconds = ttlToSeconds(shard.processTtlQuery(query));
+        return protocol == RequestProtocol::RESP ? makeRespInteger(seconds) : makeCustomInteger(seconds);
+    };
+
     if (request.protocol == RequestProtocol::RESP) {
         auto markRespTransactionError = [&]() {
             if (connData.respTransaction && connData.respTransaction->active) {
@@ -158,7 +315,7 @@ ResponsePacket CacheServer::processRequestSync(const RequestView& request, Conne
             return *connData.respTransaction;
         };
 
-        auto queueRespCommand = [&](RespTransactionState::CommandType type, const char* key, const char* value) -> ResponsePacket {
+        auto queueRespCommand = [&](RespTransactionState::CommandType type, std::string_view key, std::string_view value, int_fast64_t ttlMs = 0) -> ResponsePacket {
             auto& tx = ensureRespTransaction();
             if (!tx.active) {
                 ++numErrors;
@@ -169,17 +326,19 @@ ResponsePacket CacheServer::processRequestSync(const RequestView& request, Conne
             queued.type = type;
             queued.key = tx.persistString(key);
             queued.value = tx.persistString(value);
+            queued.ttlMs = ttlMs;
             return makeRespSimpleString(QUEUED_STR);
         };
 
-        RespCommandParts parts{};
-        if (!parseRespCommand(request.payload, parts)) {
+        const auto& parts = prepared.parts;
+        if (!prepared.parsed) {
             ++numErrors;
             markRespTransactionError();
             return makeErrorResponse(RequestProtocol::RESP, UNABLE_TO_PARSE_REQUEST_ERROR);
         }
 
-        if (std::strcmp(parts.command, MULTI_STR) == 0) {
+        const std::string_view command{parts.command, parts.commandLen};
+        if (command == MULTI_STR) {
             auto& tx = ensureRespTransaction();
             if (tx.active) {
                 ++numErrors;
@@ -192,7 +351,7 @@ ResponsePacket CacheServer::processRequestSync(const RequestView& request, Conne
             return makeRespSimpleString(OK);
         }
 
-        if (std::strcmp(parts.command, DISCARD_STR) == 0) {
+        if (command == DISCARD_STR) {
             if (!connData.respTransaction || !connData.respTransaction->active) {
                 ++numErrors;
                 return makeRespError(RESP_ERR_DISCARD_NO_MULTI);
@@ -204,7 +363,7 @@ ResponsePacket CacheServer::processRequestSync(const RequestView& request, Conne
             return makeRespSimpleString(OK);
         }
 
-        if (std::strcmp(parts.command, EXEC_STR) == 0) {
+        if (command == EXEC_STR) {
             if (!connData.respTransaction || !connData.respTransaction->active) {
                 ++numErrors;
                 return makeRespError(RESP_ERR_EXEC_NO_MULTI);
@@ -225,11 +384,20 @@ ResponsePacket CacheServer::processRequestSync(const RequestView& request, Conne
                         results.emplace_back(handleGet(queued.key, RequestProtocol::RESP));
                         break;
                     case RespTransactionState::CommandType::Set:
-                        results.emplace_back(handleSet(queued.key, queued.value, RequestProtocol::RESP));
+                        results.emplace_back(handleSet(queued.key, queued.value, queued.ttlMs, RequestProtocol::RESP));
                         break;
                     case RespTransactionState::CommandType::Del:
                         results.emplace_back(handleDel(queued.key, RequestProtocol::RESP));
                         break;
+                    case RespTransactionState::CommandType::Expire:
+                        results.emplace_back(handleExpire(queued.key, queued.ttlMs, RequestProtocol::RESP));
+                        break;
+                    case RespTransactionState::CommandType::Ttl:
+                        results.emplace_back(handleTtl(queued.key, RequestProtocol::RESP));
+                        break;
+                    case RespTransactionState::CommandType::Persist:
+                        results.emplace_back(handlePersist(queued.key, RequestProtocol::RESP));
+                        break;
                 }
             }
             tx.clearQueue();
@@ -238,40 +406,96 @@ ResponsePacket CacheServer::processRequestSync(const RequestView& request, Conne
             return makeRespArray(results);
         }
 
-        if (std::strcmp(parts.command, GET_STR) == 0) {
+        if (command == GET_STR) {
+            if (parts.argc != 2) {
+                ++numErrors;
+                markRespTransactionError();
+                return makeErrorResponse(RequestProtocol::RESP, INVALID_COMMAND_FORMAT);
+            }
+            if (connData.respTransaction && connData.respTransaction->active) {
+                return queueRespCommand(RespTransactionState::CommandType::Get, {parts.key, parts.keyLen}, {});
+            }
+            return handleGet({parts.key, parts.keyLen}, RequestProtocol::RESP);
+        }
+
+        if (command == SET_STR) {
+            if ((parts.argc != 3 && parts.argc != 5) || parts.value == nullptr) {
+                ++numErrors;
+                markRespTransactionError();
+                return makeErrorResponse(RequestProtocol::RESP, INVALID_COMMAND_FORMAT);
+            }
+            int_fast64_t ttlMs = 0;
+            if (parts.argc == 5) {
+                const auto& unit = parts.options[0];
+                if (unit != EX_STR && unit != PX_STR) {
+                    ++numErrors;
+                    markRespTransactionError();
+                    return makeErrorResponse(RequestProtocol::RESP, INVALID_COMMAND_FORMAT);
+                }
+                if (!parseExpireTime(parts.options[1], unit == EX_STR ? 1000 : 1, ttlMs) || ttlMs <= 0) {
+                    ++numErrors;
+                    markRespTransactionError();
+                    return makeErrorResponse(RequestProtocol::RESP, INVALID_EXPIRE_TIME);
+                }
+            }
+            if (connData.respTransaction && connData.respTransaction->active) {
+                return queueRespCommand(RespTransactionState::CommandType::Set, {parts.key, parts.keyLen}, {parts.value, parts.valueLen}, ttlMs);
+            }
+            return handleSet({parts.key, parts.keyLen}, {parts.value, parts.valueLen}, ttlMs, RequestProtocol::RESP);
+        }
+
+        if (command == DEL_STR) {
             if (parts.argc != 2) {
                 ++numErrors;
                 markRespTransactionError();
                 return makeErrorResponse(RequestProtocol::RESP, INVALID_COMMAND_FORMAT);
             }
             if (connData.respTransaction && connData.respTransaction->active) {
-                return queueRespCommand(RespTransactionState::CommandType::Get, parts.key, nullptr);
+                return queueRespCommand(RespTransactionState::CommandType::Del, {parts.key, parts.keyLen}, {});
+            }
+            return handleDel({parts.key, parts.keyLen}, RequestProtocol::RESP);
+        }
+
+        if (command == EXPIRE_STR) {
+            int_fast64_t ttlMs = 0;
+            if (parts.argc != 3) {
+                ++numErrors;
+                markRespTransactionError();
+                return makeErrorResponse(RequestProtocol::RESP, INVALID_COMMAND_FORMAT);
+            }
+            if (!parseExpireTime({parts.value, parts.valueLen}, 1000, ttlMs)) {
+                ++numErrors;
+                markRespTransactionError();
+                return makeErrorResponse(RequestProtocol::RESP, INVALID_EXPIRE_TIME);
+            }
+            if (connData.respTransaction && connData.respTransaction->active) {
+                return queueRespCommand(RespTransactionState::CommandType::Expire, {parts.key, parts.keyLen}, {}, ttlMs);
             }
-            return handleGet(parts.key, RequestProtocol::RESP);
+            return handleExpire({parts.key, parts.keyLen}, ttlMs, RequestProtocol::RESP);
         }
 
-        if (std::strcmp(parts.command, SET_STR) == 0) {
-            if (parts.argc != 3 || parts.value == nullptr) {
+        if (command == TTL_STR) {
+            if (parts.argc != 2) {
                 ++numErrors;
                 markRespTransactionError();
                 return makeErrorResponse(RequestProtocol::RESP, INVALID_COMMAND_FORMAT);
             }
             if (connData.respTransaction && connData.respTransaction->active) {
-                return queueRespCommand(RespTransactionState::CommandType::Set, parts.key, parts.value);
+                return queueRespCommand(RespTransactionState::CommandType::Ttl, {parts.key, parts.keyLen}, {});
             }
-            return handleSet(parts.key, parts.value, RequestProtocol::RESP);
+            return handleTtl({parts.key, parts.keyLen}, RequestProtocol::RESP);
         }
 
-        if (std::strcmp(parts.command, DEL_STR) == 0) {
+        if (command == PERSIST_STR) {
             if (parts.argc != 2) {
                 ++numErrors;
                 markRespTransactionError();
                 return makeErrorResponse(RequestProtocol::RESP, INVALID_COMMAND_FORMAT);
             }
             if (connData.respTransaction && connData.respTransaction->active) {
-                return queueRespCommand(RespTransactionState::CommandType::Del, parts.key, nullptr);
+                return queueRespCommand(RespTransactionState::CommandType::Persist, {parts.key, parts.keyLen}, {});
             }
-            return handleDel(parts.key, RequestProtocol::RESP);
+            return handlePersist({parts.key, parts.keyLen}, RequestProtocol::RESP);
         }
 
         ++numErrors;
@@ -293,28 +517,39 @@ ResponsePacket CacheServer::processRequestSync(const RequestView& request, Conne
     }
 
     const auto secondSpace = remainder.find(' ');
-    char* keyPtr = const_cast<char*>(remainder.data());
-    const char* valuePtr = nullptr;
-
-    if (secondSpace != std::string_view::npos) {
-        keyPtr[secondSpace] = '\0';
-        valuePtr = keyPtr + secondSpace + 1;
-    }
+    const auto key = remainder.substr(0, secondSpace);
 
     if (command == GET_STR) {
-        return handleGet(keyPtr, RequestProtocol::Custom);
+        return handleGet(key, RequestProtocol::Custom);
     }
 
     if (command == SET_STR) {
-        if (!valuePtr) {
+        if (secondSpace == std::string_view::npos) {
             ++numErrors;
             return makeErrorResponse(RequestProtocol::Custom, INVALID_COMMAND_FORMAT);
         }
-        return handleSet(keyPtr, valuePtr, RequestProtocol::Custom);
+        return handleSet(key, remainder.substr(secondSpace + 1), 0, RequestProtocol::Custom);
     }
 
     if (command == DEL_STR) {
-        return handleDel(keyPtr, RequestProtocol::Custom);
+        return handleDel(key, RequestProtocol::Custom);
+    }
+
+    if (command == EXPIRE_STR) {
+        int_fast64_t ttlMs = 0;
+        if (secondSpace == std::string_view::npos || !parseExpireTime(remainder.substr(secondSpace + 1), 1000, ttlMs)) {
+            ++numErrors;
+            return makeErrorResponse(RequestProtocol::Custom, INVALID_EXPIRE_TIME);
+        }
+        return handleExpire(key, ttlMs, RequestProtocol::Custom);
+    }
+
+    if (command == TTL_STR) {
+        return handleTtl(key, RequestProtocol::Custom);
+    }
+
+    if (command == PERSIST_STR) {
+        return handlePersist(key, RequestProtocol::Custom);
     }
 
     ++numErrors;
@@ -338,6 +573,13 @@ HandleReqTask CacheServer::handleRequests()
 #ifndef NDEBUG
             std::cout << "handleRequests finished without events to handle!\n";
 #endif
+            {
+                const std::lock_guard<std::mutex> lock(req_handle_mutex);
+                for (auto& shard : serverShards) {
+                    for (uint_fast32_t step = 0; step < MAINTENANCE_STEPS_PER_IDLE_TICK && shard.runMaintenance(); ++step);
+                }
+                removeExpiredKeys();
+            }
             co_yield event_count;
         } else {
             std::vector<AsyncReadTask> readers;
@@ -372,10 +614,16 @@ HandleReqTask CacheServer::handleRequests()
 
                 auto& connData = connManager->connections[fd];
                 auto& responses = responsesPerConn[fd];
+                // Parse the whole pipeline and hash its keys in one batch before dispatching to shards
+                preparedRequests.clear();
                 while (!connData.pendingRequests.empty()) {
-                    auto req = connData.pendingRequests.front();
+                    preparedRequests.push_back(PreparedRequest{connData.pendingRequests.front()});
                     connData.pendingRequests.pop_front();
-                    responses.emplace_back(processRequestSync(req, connData));
+                    prepareRequest(preparedRequests.back());
+                }
+                hashPreparedKeys(preparedRequests);
+                for (auto& prepared : preparedRequests) {
+                    responses.emplace_back(processRequestSync(prepared, connData));
                 }
                 if (connData.bytesToErase > 0) {
                     connData.readBuffer.erase(connData.readBuffer.begin(), connData.readBuffer.begin() + connData.bytesToErase);
@@ -389,6 +637,17 @@ HandleReqTask CacheServer::handleRequests()
                 }
             }
 
+            {
+                const std::lock_guard<std::mutex> lock(req_handle_mutex);
+                // Sent responses unpin stored values, stores are modified under the request lock only
+                responsesPerConn.clear();
+                // Idle ticks never come under steady traffic, background work has to advance between batches too
+                for (auto& shard : serverShards) {
+                    for (uint_fast32_t step = 0; step < MAINTENANCE_STEPS_PER_BUSY_BATCH && shard.runMaintenance(); ++step);
+                }
+                removeExpiredKeys();
+            }
+
 #ifndef NDEBUG
             auto stop = std::chrono::high_resolution_clock::now();
             auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start);
@@ -399,6 +658,20 @@ HandleReqTask CacheServer::handleRequests()
     }
 }
 
+void CacheServer::removeExpiredKeys()
+{
+    const auto deadline = std::chrono::steady_clock::now() + expirationBudget;
+    // Walk shards round robin until every shard reports no expired keys in a row or the budget is spent
+    for (uint_fast16_t idleShards = 0; idleShards < numShards;) {
+        auto& shard = serverShards[expirationCursor];
+        expirationCursor = (expirationCursor + 1) % numShards;
+        idleShards = shard.runExpiration(EXPIRATION_RECORDS_PER_STEP) ? 0 : idleShards + 1;
+        if (std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+    }
+}
+
 AsyncReadTask server::CacheServer::readRequestAsync(int client_fd)
 {
     char buffer[READ_BUFFER_SIZE];
@@ -491,15 +764,16 @@ AsyncReadTask server::CacheServer::readRequestAsync(int client_fd)
 
 AsyncSendTask CacheServer::sendResponse(int client_fd, const ResponsePacket& response) {
     char sep = MSG_SEPARATOR;
-    struct iovec iov[2];
-
-    iov[0].iov_base = const_cast<char*>(response.data);
-    iov[0].iov_len  = response.size;
-    iov[1].iov_base = &sep;
-    iov[1].iov_len  = 1;
+    struct iovec iov[4];
 
-    const size_t iovCount = response.protocol == RequestProtocol::Custom ? 2 : 1;
-    size_t totalRequired = response.size + (iovCount == 2 ? 1 : 0);
+    size_t iovCount = fillResponseIovecs(response, iov);
+    size_t totalRequired = response.totalSize();
+    if (response.protocol == RequestProtocol::Custom) {
+        iov[iovCount].iov_base = &sep;
+        iov[iovCount].iov_len  = 1;
+        ++iovCount;
+        ++totalRequired;
+    }
     size_t totalSent = 0;
     size_t iov_idx = 0;
 
@@ -540,17 +814,15 @@ AsyncSendTask CacheServer::sendResponse(int client_fd, const ResponsePacket& res
 
 void CacheServer::sendResponses(int client_fd, const std::vector<ResponsePacket>& responses) {
     std::vector<iovec> iov;
-    iov.reserve(responses.size() * 2);
+    iov.reserve(responses.size() * 4);
     std::vector<char> separators;
     separators.reserve(responses.size());
 
     size_t totalRequired = 0;
     for (const auto& response : responses) {
-        iovec dataVec{};
-        dataVec.iov_base = const_cast<char*>(response.data);
-        dataVec.iov_len = response.size;
-        iov.push_back(dataVec);
-        totalRequired += response.size;
+        iovec segments[3];
+        iov.insert(iov.end(), segments, segments + fillResponseIovecs(response, segments));
+        totalRequired += response.totalSize();
 
         if (response.protocol == RequestProtocol::Custom) {
             separators.push_back(MSG_SEPARATOR);
@@ -565,9 +837,10 @@ void CacheServer::sendResponses(int client_fd, const std::vector<ResponsePacket>
     size_t totalSent = 0;
     size_t iov_idx = 0;
 
+    // Long pipelines may have more segments than a single sendmsg accepts
     msghdr msg{};
     msg.msg_iov = iov.data();
-    msg.msg_iovlen = iov.size();
+    msg.msg_iovlen = std::min<size_t>(iov.size(), IOV_MAX);
 
     while (totalSent < totalRequired) {
         auto bytesSent = sendmsg(client_fd, &msg, 0);
@@ -596,7 +869,7 @@ void CacheServer::sendResponses(int client_fd, const std::vector<ResponsePacket>
         }
 
         msg.msg_iov = &iov[iov_idx];
-        msg.msg_iovlen = iov.size() - iov_idx;
+        msg.msg_iovlen = std::min<size_t>(iov.size() - iov_idx, IOV_MAX);
     }
 }
 
@@ -605,6 +878,18 @@ void CacheServer::metricsUpdater(MetricsChannel& channel, std::stop_token stopTo
     while (!stopToken.stop_requested()) {
         metricsSemaphore.try_acquire_for(METRICS_UPDATE_FREQUENCY_SEC);
         CacheServerMetrics metrics(numErrors.load(std::memory_order_relaxed), connManager->activeConnectionsCounter.load(std::memory_order_relaxed), numRequests.load(std::memory_order_relaxed));
+        metrics.maxMemory = maxMemory;
+        {
+            const std::lock_guard<std::mutex> lock(req_handle_mutex);
+            for (auto& shard : serverShards) {
+                metrics.memoryStats += shard.keyValueStore->getMemoryStats();
+                metrics.numExpiredKeys += shard.keyValueStore->getNumExpired();
+                metrics.numEvictions += shard.keyValueStore->getNumEvictions();
+                metrics.evictedBytes += shard.keyValueStore->getEvictedBytes();
+                metrics.usedMemory += shard.keyValueStore->getUsedMemory();
+                metrics.valueCacheStats += shard.keyValueStore->getValueCacheStats();
+            }
+        }
         channel.push(metrics);
     }
 }
@@ -36,6 +36,17 @@ namespace server {
         uint_fast64_t numErrors = 0;
         uint_fast32_t numActiveConnections = 0;
         uint_fast64_t numRequests = 0;
+        /// @brief Key and value memory usage aggregated over all shards
+        SlabAllocatorStats memoryStats{};
+        /// @brief Number of keys removed because their TTL elapsed, aggregated over all shards
+        uint_fast64_t numExpiredKeys = 0;
+        uint_fast64_t numEvictions = 0;
+        uint_fast64_t evictedBytes = 0;
+        /// @brief Memory accounted against MAX_MEMORY, aggregated over all shards
+        uint_fast64_t usedMemory = 0;
+        uint_fast64_t maxMemory = 0;
+        /// @brief Decompressed value cache hits, misses and memory usage, aggregated over all shards
+        ValueCacheStats valueCacheStats{};
 
         CacheServerMetrics() = default;
 
@@ -91,6 +102,56 @@ namespace server {
 
         /// @brief Inline RESP response capacity before falling back to heap allocations
         std::size_t respInlineCapacity = 255;
+
+        /// @brief Migrate entries to the resized table gradually instead of blocking the event loop for the whole rehash
+        bool incrementalResize = true;
+
+        /// @brief Max time spent on removing expired keys per event loop iteration, in microseconds
+        uint_fast32_t expirationBudgetUsec = 250;
+
+        /// @brief Max memory used by keys and values of all shards in bytes, split evenly between shards, 0 - unlimited
+        uint_fast64_t maxMemory = 0;
+
+        /// @brief Which keys to evict when a shard reaches its memory limit
+        EvictionPolicy evictionPolicy = EvictionPolicy::LRU;
+
+        /// @brief Grow shard tables through prime sizes (modulo indexing) instead of powers of two (mask indexing)
+        bool usePrimeTableSizes = true;
+
+        /// @brief zlib level of value compression when enableCompression is set, 1 - fastest, 9 - best ratio
+        int compressionLevel = GZIP_DEFAULT_LEVEL;
+
+        /// @brief Codec of stored values when enableCompression is set
+        CodecId valueCodec = CodecId::Lz4;
+
+        /// @brief Size of the compression dictionary each shard trains from sampled values, lets values of a few hundred bytes compress well. 0 - disabled
+        size_t dictionarySize = DICT_DEFAULT_SIZE;
+
+        /// @brief Min percentage of value size compression has to save, otherwise the value is stored as is
+        uint_fast32_t minCompressionSavings = MIN_COMPRESSION_SAVINGS_PERCENT;
+
+        /// @brief Store values uncompressed and compress them on idle ticks once they are not read for this many milliseconds, 0 - compress on SET
+        uint_fast64_t compressColdAfterMs = 0;
+
+        /// @brief Max bytes of decompressed values cached for repeated GETs of compressed keys, split evenly between shards, 0 - disabled
+        uint_fast64_t valueCacheSize = 64 * 1024 * 1024;
+
+        /// @brief Store uncompressed values with their RESP bulk string framing, so RESP GETs send stored bytes as is
+        bool respFraming = false;
+
+        /// @brief Threads migrating keys of a shard during a blocking resize (incrementalResize off), 0 - all hardware threads
+        uint_fast32_t rehashThreads = 1;
+    };
+
+    /// @brief Request whose command is parsed and key is hashed before execution, so keys of a whole batch are hashed together
+    struct PreparedRequest {
+        RequestView request{};
+        RespCommandParts parts{};
+        /// @brief RESP request was parsed into parts successfully
+        bool parsed = false;
+        /// @brief Key argument, data is nullptr if the request has none
+        std::string_view key{};
+        uint_fast64_t keyHash = 0;
     };
 
     class CacheServer : NonCopyableOrMovable {
@@ -116,15 +177,27 @@ namespace server {
 
             uint_fast16_t numShards;
             std::vector<ServerShard> serverShards;
+            std::chrono::microseconds expirationBudget;
+            uint_fast64_t maxMemory;
+            /// @brief Shard which starts next active expiration round, so every shard gets its share of the budget
+            uint_fast16_t expirationCursor = 0;
             int port;
             int server_fd;
             int epoll_fd;
             epoll_event epoll_events[MAX_EVENTS];
+            /// @brief Buffers of the request batch which is being processed, reused between event loop iterations
+            std::vector<PreparedRequest> preparedRequests;
+            std::vector<std::string_view> batchKeys;
+            std::vector<uint_fast64_t> batchHashes;
 
             AsyncReadTask readRequestAsync(int client_fd);
             ProcessRequestTask processRequest(const RequestView& request, int client_fd);
             ResponsePacket processRequestSync(const RequestView& request, ConnectionData& connData);
+            ResponsePacket processRequestSync(PreparedRequest& prepared, ConnectionData& connData);
+            void prepareRequest(PreparedRequest& prepared);
+            void hashPreparedKeys(std::vector<PreparedRequest>& batch);
             HandleReqTask handleRequests();
+            void removeExpiredKeys();
             AsyncSendTask sendResponse(int client_fd, const ResponsePacket& response);
             void sendResponses(int client_fd, const std::vector<ResponsePacket>& responses);
             void metricsUpdater(MetricsChannel& channel, std::stop_token stopToken);
@@ -8,50 +8,63 @@ const char* ServerShard::processCommand(const Command& command)
     switch (command.commandCode)
     {
         case CommandCode::SET:
-            opRes = keyValueStore->set(command.key.get(), command.value.get(), command.hash);
-            return opRes ? OK : INTERNAL_ERROR;
+            opRes = keyValueStore->set(command.key.data(), command.key.size(), command.value.data(), command.value.size(), command.hash, static_cast<uint_fast64_t>(command.ttlMs));
+            if (opRes) {
+                return OK;
+            }
+            return keyValueStore->isOutOfMemory() ? OUT_OF_MEMORY : INTERNAL_ERROR;
 
         case CommandCode::DEL:
-            opRes = keyValueStore->del(command.key.get(), command.hash);
+            opRes = keyValueStore->del(command.key.data(), command.key.size(), command.hash);
             return opRes ? OK : KEY_NOT_EXISTS;
-        
+
+        case CommandCode::EXPIRE:
+            opRes = keyValueStore->expire(command.key.data(), command.key.size(), command.hash, command.ttlMs);
+            return opRes ? OK : KEY_NOT_EXISTS;
+
+        case CommandCode::PERSIST:
+            opRes = keyValueStore->persist(command.key.data(), command.key.size(), command.hash);
+            return opRes ? OK : KEY_NOT_EXISTS;
+
         default:
             return INVALID_COMMAND_CODE;
     }
 }
 
-const char* ServerShard::processQuery(const Query& query)
+ValueView ServerShard::processQuery(const Query& query)
 {
-    const char* value = nullptr;
+    ValueView value{};
     switch (query.queryCode)
     {
         case QueryCode::GET:
-            value = keyValueStore->get(query.key.get(), query.hash);
-            return value ? value : NOTHING;
+            value = keyValueStore->get(query.key.data(), query.key.size(), query.hash);
+            return value ? value : ValueView{ NOTHING, strlen(NOTHING) };
 
         default:
-            return INVALID_QUERY_CODE;
+            return ValueView{ INVALID_QUERY_CODE, strlen(INVALID_QUERY_CODE) };
     }
 }
 
-server::Query::Query(QueryCode code, const char *arg_key, uint_fast64_t hash): queryCode(code), hash(hash)
+int_fast64_t ServerShard::processTtlQuery(const Query& query)
 {
-    auto kSize = strlen(arg_key) + 1;
-    key = std::make_unique<char[]>(kSize);
-    memcpy(key.get(), arg_key, kSize);
-    key.get()[kSize-1] = '\0';
+    return keyValueStore->ttl(query.key.data(), query.key.size(), query.hash);
 }
 
-server::Command::Command(CommandCode code, const char *arg_key, const char *arg_value, uint_fast64_t hash): commandCode(code), hash(hash)
+bool ServerShard::runMaintenance()
 {
-    if (arg_value) { // not every command has value, e.g. DEL key1
-        auto vSize = strlen(arg_value) + 1;
-        value = std::make_unique<char[]>(vSize);
-        memcpy(value.get(), arg_value, vSize);
-        value.get()[vSize-1] = '\0';
-    }
-    auto kSize = strlen(arg_key) + 1;
-    key = std::make_unique<char[]>(kSize);
-    memcpy(key.get(), arg_key, kSize);
-    key.get()[kSize-1] = '\0';
-}
\ No newline at end of file
+    return keyValueStore->maintenance();
+}
+
+bool ServerShard::runExpiration(uint_fast32_t maxRecords)
+{
+    return keyValueStore->removeExpired(maxRecords);
+}
+
+server::Query::Query(QueryCode code, std::string_view arg_key, uint_fast64_t hash): queryCode(code), key(arg_key), hash(hash)
+{
+}
+
+server::Command::Command(CommandCode code, std::string_view arg_key, std::string_view arg_value, uint_fast64_t hash, int_fast64_t ttlMs)
+    : commandCode(code), key(arg_key), value(arg_value), hash(hash), ttlMs(ttlMs) // not every command has value, e.g. DEL key1
+{
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 #include <functional>
+#include <string_view>
 #include "../non_copyable.hpp"
 #include "../kvs/kvs.hpp"
 #include "conn_manager.hpp"
@@ -11,21 +12,24 @@
 namespace server {
     using namespace kvs;
 
-     struct alignas(64) Command {
+    /// @brief Key and value reference the request buffer, which outlives the command processing
+    struct alignas(64) Command {
         CommandCode commandCode;
-        std::unique_ptr<char[]> key;
-        std::unique_ptr<char[]> value;
+        std::string_view key;
+        std::string_view value;
         uint_fast64_t hash;
+        /// @brief Time to live in milliseconds for SET (0 - no expiration) and EXPIRE
+        int_fast64_t ttlMs;
 
-        Command(CommandCode code, const char* arg_key, const char* arg_value, uint_fast64_t hash);
+        Command(CommandCode code, std::string_view arg_key, std::string_view arg_value, uint_fast64_t hash, int_fast64_t ttlMs = 0);
     };
 
     struct alignas(64) Query {
         QueryCode queryCode;
-        std::unique_ptr<char[]> key;
+        std::string_view key;
         uint_fast64_t hash;
 
-        Query(QueryCode code, const char* arg_key, uint_fast64_t hash);
+        Query(QueryCode code, std::string_view arg_key, uint_fast64_t hash);
     };
 
     struct ServerShard {
@@ -39,6 +43,18 @@ namespace server {
             };
 
             const char* processCommand(const Command& command);
-            const char* processQuery(const Query& query);
+            /// @brief Returns stored value, NOTHING if key does not exist or error message on invalid query
+            ValueView processQuery(const Query& query);
+
+            /// @brief Returns remaining time to live of the key in milliseconds, TTL_NO_EXPIRY or TTL_KEY_NOT_FOUND
+            int_fast64_t processTtlQuery(const Query& query);
+
+            /// @brief Runs bounded background work of the shard storage, e.g. incremental resize
+            /// @return true if there is pending work left
+            bool runMaintenance();
+
+            /// @brief Removes keys whose TTL elapsed, examines at most maxRecords scheduled expirations
+            /// @return true if there are more expired keys to remove
+            bool runExpiration(uint_fast32_t maxRecords);
     };
 }
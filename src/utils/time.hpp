@@ -1,5 +1,6 @@
 #pragma once
 #include <time.h>
+#include <cstdint>
 
 // Constant for nanoseconds per second.
 constexpr long NANOSECONDS_IN_SECOND = 1000000000L;
@@ -22,3 +23,10 @@ inline void resetTimespec(timespec &ts) {
     ts.tv_sec = 0;
     ts.tv_nsec = 0;
 };
+
+/// @brief Milliseconds of the monotonic clock, used for key expiration
+inline uint_fast64_t monotonicMsec() noexcept {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint_fast64_t>(ts.tv_sec) * 1000 + static_cast<uint_fast64_t>(ts.tv_nsec) / 1000000;
+}